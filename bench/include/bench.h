@@ -0,0 +1,40 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+// Results are folded in here so the optimizer can't drop the measured work
+inline volatile std::size_t bench_sink = 0;
+
+inline void keep(std::size_t value) {
+    bench_sink = bench_sink + value;
+}
+
+// Iteration count from argv[index], or the default when it is absent
+inline long benchArgument(int argc, char* argv[], int index, long default_value) {
+    if (argc > index) {
+        long value = std::strtol(argv[index], nullptr, 10);
+        if (value > 0) {
+            return value;
+        }
+    }
+    return default_value;
+}
+
+// Calls fn(i) for i in [0, iterations) and prints the mean cost of one call in ns
+template <typename Fn>
+double measure(const char* name, long iterations, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        fn(i);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    double per_call = elapsed.count() / static_cast<double>(iterations);
+    std::printf("%-44s %12.1f ns/op  (%ld runs)\n", name, per_call, iterations);
+    return per_call;
+}
+
+#endif // BENCH_H
@@ -0,0 +1,161 @@
+// Offline drain query on a large messages table,
+// with the indexes from the schema migrations and after dropping them (full scans).
+// Prints EXPLAIN QUERY PLAN and the mean time per query for both.
+// Usage: bench_message_index [rows] [database path]; the database is deleted afterwards
+#include "include/bench.h"
+#include "include/logger.h"
+#include "include/prepared_statement.h"
+#include "include/schema_migrations.h"
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <sqlite3.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Same SQL as Database::select_offline_page
+constexpr const char* kOfflinePage =
+    "SELECT id, sender_id, receiver_id, content, sent_at, is_file, file_path, is_delivered, seq FROM messages "
+    "WHERE receiver_id = ? AND is_delivered = 0 AND id > ? ORDER BY id LIMIT ?;";
+
+constexpr int kUsers = 1000;
+constexpr int kPageSize = 256;
+constexpr int kUndeliveredPercent = 1; // Очередь офлайн-доставки мала по сравнению с историей
+
+void exec(sqlite3* db, const char* sql) {
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        std::string error = err_msg ? err_msg : sqlite3_errmsg(db);
+        sqlite3_free(err_msg);
+        throw std::runtime_error(error);
+    }
+}
+
+void fill(sqlite3* db, long rows) {
+    exec(db, "BEGIN;");
+    PreparedStatement add_user(db, "INSERT INTO users (username, email, password_hash) VALUES (?, ?, ?);");
+    for (int i = 0; i < kUsers; ++i) {
+        std::string username = "user" + std::to_string(i);
+        std::string email = username + "@example.com";
+        StatementScope stmt(add_user);
+        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, email.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 3, "hash", -1, SQLITE_STATIC);
+        sqlite3_step(stmt);
+    }
+
+    PreparedStatement store_message(db,
+        "INSERT INTO messages (sender_id, receiver_id, content, sent_at, seq, is_file, file_path, is_delivered) "
+        "VALUES (?, ?, ?, ?, ?, 0, NULL, ?);");
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> user(1, kUsers);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::vector<std::int64_t> stream_seq(static_cast<std::size_t>(kUsers + 1) * (kUsers + 1), 0);
+    for (long i = 0; i < rows; ++i) {
+        int sender = user(random);
+        int receiver = user(random);
+        std::int64_t seq = ++stream_seq[static_cast<std::size_t>(sender) * (kUsers + 1) + receiver];
+        StatementScope stmt(store_message);
+        sqlite3_bind_int(stmt, 1, sender);
+        sqlite3_bind_int(stmt, 2, receiver);
+        sqlite3_bind_text(stmt, 3, "message text of a typical length for a chat", -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 4, 1700000000000 + i);
+        sqlite3_bind_int64(stmt, 5, seq);
+        sqlite3_bind_int(stmt, 6, percent(random) < kUndeliveredPercent ? 0 : 1);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            throw std::runtime_error(sqlite3_errmsg(db));
+        }
+    }
+    exec(db, "COMMIT;");
+    exec(db, "ANALYZE;");
+}
+
+// Every index the migrations created on messages (autoindexes have no sql)
+std::vector<std::string> messageIndexes(sqlite3* db) {
+    PreparedStatement list(db,
+        "SELECT name FROM sqlite_master WHERE type = 'index' AND tbl_name = 'messages' AND sql IS NOT NULL;");
+    StatementScope stmt(list);
+    std::vector<std::string> names;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        names.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+    }
+    return names;
+}
+
+void printPlan(sqlite3* db, const char* sql) {
+    std::string explain = std::string("EXPLAIN QUERY PLAN ") + sql;
+    PreparedStatement plan(db, explain.c_str());
+    StatementScope stmt(plan);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::printf("    plan: %s\n", reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)));
+    }
+}
+
+std::size_t drainRows(sqlite3_stmt* stmt) {
+    std::size_t rows = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        ++rows;
+    }
+    return rows;
+}
+
+void runQueries(sqlite3* db, long runs) {
+    std::printf("  offline page (LIMIT %d)\n", kPageSize);
+    printPlan(db, kOfflinePage);
+    PreparedStatement offline_page(db, kOfflinePage);
+    measure("    query", runs, [&](long i) {
+        StatementScope stmt(offline_page);
+        sqlite3_bind_int(stmt, 1, static_cast<int>(i % kUsers) + 1);
+        sqlite3_bind_int64(stmt, 2, 0);
+        sqlite3_bind_int(stmt, 3, kPageSize);
+        keep(drainRows(stmt));
+    });
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    long rows = benchArgument(argc, argv, 1, 2000000);
+    std::string path = argc > 2 ? argv[2] : "bench_message_index.db";
+    Logger::instance().setLevel(LogLevel::Warn);
+
+    auto remove_database = [&path]() {
+        for (const char* suffix : {"", "-wal", "-shm", "-journal"}) {
+            std::remove((path + suffix).c_str());
+        }
+    };
+    remove_database();
+    sqlite3* db = nullptr;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::printf("can't open %s: %s\n", path.c_str(), sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return 1;
+    }
+    try {
+        exec(db, "PRAGMA journal_mode = WAL; PRAGMA synchronous = OFF;");
+        applyMigrations(db);
+        std::printf("filling %ld messages between %d users into %s\n", rows, kUsers, path.c_str());
+        fill(db, rows);
+
+        std::printf("with migration indexes\n");
+        runQueries(db, 2000);
+
+        // Без индексов каждый запрос - полный проход по таблице, поэтому запусков меньше
+        for (const std::string& name : messageIndexes(db)) {
+            exec(db, ("DROP INDEX " + name + ";").c_str());
+        }
+        std::printf("without indexes\n");
+        runQueries(db, 20);
+    } catch (const std::exception& e) {
+        std::printf("benchmark failed: %s\n", e.what());
+        sqlite3_close(db);
+        remove_database();
+        return 1;
+    }
+    sqlite3_close(db);
+    remove_database();
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Cost of parsing one client frame: nlohmann DOM plus field lookups (the fallback
+// path of JsonParser) versus FastRequestParser.
+// Usage: bench_request_parser [iterations]
+#include "include/bench.h"
+#include "include/fast_request_parser.h"
+#include <nlohmann/json.hpp>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+struct Frame {
+    const char* name;
+    std::string text;
+};
+
+std::vector<Frame> sampleFrames() {
+    std::string content(200, 'x');
+    std::string escaped = "line one\\nline \\\"two\\\" " + std::string(180, 'y');
+    return {
+        {"message", R"({"type":"message","to":"bob","content":")" + content + R"("})"},
+        {"message with escapes", R"({"type":"message","to":"bob","content":")" + escaped + R"("})"},
+        {"typing", R"({"type":"typing","to":"bob","is_typing":true})"},
+        {"login", R"({"type":"login","username":"alice","password":"secret"})"},
+    };
+}
+
+// What the DOM handlers do per frame: parse, dispatch on "type", copy the fields out
+std::size_t parseDom(const std::string& text) {
+    json message = json::parse(text);
+    std::size_t total = message["type"].get<std::string>().size();
+    for (const char* key : {"to", "content", "username", "password"}) {
+        if (message.contains(key)) {
+            total += message[key].get<std::string>().size();
+        }
+    }
+    if (message.contains("is_typing")) {
+        total += message["is_typing"].get<bool>();
+    }
+    return total;
+}
+
+// JsonParser::parseMessage creates a parser per frame, so does the benchmark
+std::size_t parseFast(const std::string& text) {
+    FastRequestParser parser;
+    FastRequest request = parser.parse(text);
+    return std::visit(
+        [](const auto& fields) -> std::size_t {
+            using T = std::decay_t<decltype(fields)>;
+            if constexpr (std::is_same_v<T, ChatMessageRequest>) {
+                return fields.to.size() + fields.content.size();
+            } else if constexpr (std::is_same_v<T, TypingRequest>) {
+                return fields.to.size() + fields.is_typing;
+            } else if constexpr (std::is_same_v<T, LoginRequest>) {
+                return fields.username.size() + fields.password.size();
+            } else {
+                return 0;
+            }
+        },
+        request);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    long iterations = benchArgument(argc, argv, 1, 1000000);
+
+    for (const Frame& frame : sampleFrames()) {
+        if (parseFast(frame.text) == 0) {
+            std::printf("%s: fast path rejected the frame\n", frame.name);
+            return 1;
+        }
+        std::printf("%s (%zu bytes)\n", frame.name, frame.text.size());
+        double dom = measure("  nlohmann DOM", iterations, [&](long) { keep(parseDom(frame.text)); });
+        double fast = measure("  FastRequestParser", iterations, [&](long) { keep(parseFast(frame.text)); });
+        std::printf("  speedup x%.1f\n", dom / fast);
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+// Per-call cost of a Database query with sqlite3_prepare_v2/finalize on every call
+// versus a PreparedStatement prepared once and reused through StatementScope.
+// Runs on an in-memory users/messages database, so parsing SQL is not hidden behind I/O.
+// Usage: bench_statement_cache [iterations]
+#include "include/bench.h"
+#include "include/prepared_statement.h"
+#include <sqlite3.h>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr const char* kSchema =
+    "CREATE TABLE users ("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "username TEXT NOT NULL UNIQUE,"
+    "email TEXT NOT NULL UNIQUE,"
+    "password_hash TEXT NOT NULL,"
+    "created_at DATETIME DEFAULT CURRENT_TIMESTAMP);"
+    "CREATE TABLE messages ("
+    "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "sender_id INTEGER NOT NULL,"
+    "receiver_id INTEGER NOT NULL,"
+    "content TEXT NOT NULL,"
+    "sent_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
+    "is_file BOOLEAN DEFAULT FALSE,"
+    "file_path TEXT,"
+    "is_delivered BOOLEAN DEFAULT FALSE,"
+    "FOREIGN KEY(sender_id) REFERENCES users(id),"
+    "FOREIGN KEY(receiver_id) REFERENCES users(id));";
+
+// Same SQL as Database::getUser and the group-commit INSERT
+constexpr const char* kGetUser =
+    "SELECT id, username, email, password_hash, created_at FROM users WHERE username = ?;";
+constexpr const char* kStoreMessage =
+    "INSERT INTO messages (sender_id, receiver_id, content, is_file, file_path, is_delivered) "
+    "VALUES (?, ?, ?, ?, ?, ?);";
+
+constexpr int kUsers = 10000;
+
+void exec(sqlite3* db, const char* sql) {
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        std::string error = err_msg ? err_msg : sqlite3_errmsg(db);
+        sqlite3_free(err_msg);
+        throw std::runtime_error(error);
+    }
+}
+
+void fillUsers(sqlite3* db) {
+    exec(db, "BEGIN;");
+    PreparedStatement insert(db, "INSERT INTO users (username, email, password_hash) VALUES (?, ?, ?);");
+    for (int i = 0; i < kUsers; ++i) {
+        std::string username = "user" + std::to_string(i);
+        std::string email = username + "@example.com";
+        StatementScope stmt(insert);
+        sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, email.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 3, "hash", -1, SQLITE_STATIC);
+        sqlite3_step(stmt);
+    }
+    exec(db, "COMMIT;");
+}
+
+std::size_t readUser(sqlite3_stmt* stmt, long i) {
+    std::string username = "user" + std::to_string(i % kUsers);
+    sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
+    std::size_t found = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        found = static_cast<std::size_t>(sqlite3_column_int(stmt, 0));
+    }
+    return found;
+}
+
+void bindMessage(sqlite3_stmt* stmt, long i) {
+    sqlite3_bind_int(stmt, 1, static_cast<int>(i % kUsers) + 1);
+    sqlite3_bind_int(stmt, 2, static_cast<int>((i + 1) % kUsers) + 1);
+    sqlite3_bind_text(stmt, 3, "hello, this is a benchmark message", -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 4, 0);
+    sqlite3_bind_null(stmt, 5);
+    sqlite3_bind_int(stmt, 6, 0);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    long iterations = benchArgument(argc, argv, 1, 200000);
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open(":memory:", &db) != SQLITE_OK) {
+        std::printf("can't open database: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    try {
+        exec(db, kSchema);
+        fillUsers(db);
+
+        std::printf("getUser\n");
+        double per_call = measure("  prepare + finalize per call", iterations, [&](long i) {
+            sqlite3_stmt* stmt = nullptr;
+            sqlite3_prepare_v2(db, kGetUser, -1, &stmt, nullptr);
+            keep(readUser(stmt, i));
+            sqlite3_finalize(stmt);
+        });
+        double cached = 0;
+        {
+            PreparedStatement get_user(db, kGetUser);
+            cached = measure("  cached statement", iterations, [&](long i) {
+                StatementScope stmt(get_user);
+                keep(readUser(stmt, i));
+            });
+        }
+        std::printf("  saved %.1f ns per call (x%.1f)\n", per_call - cached, per_call / cached);
+
+        // Одна транзакция на все вставки: иначе время уходит на коммиты, а не на SQL
+        std::printf("store message\n");
+        exec(db, "BEGIN;");
+        per_call = measure("  prepare + finalize per call", iterations, [&](long i) {
+            sqlite3_stmt* stmt = nullptr;
+            sqlite3_prepare_v2(db, kStoreMessage, -1, &stmt, nullptr);
+            bindMessage(stmt, i);
+            keep(sqlite3_step(stmt));
+            sqlite3_finalize(stmt);
+        });
+        {
+            PreparedStatement store_message(db, kStoreMessage);
+            cached = measure("  cached statement", iterations, [&](long i) {
+                StatementScope stmt(store_message);
+                bindMessage(stmt, i);
+                keep(sqlite3_step(stmt));
+            });
+        }
+        exec(db, "COMMIT;");
+        std::printf("  saved %.1f ns per call (x%.1f)\n", per_call - cached, per_call / cached);
+    } catch (const std::exception& e) {
+        std::printf("benchmark failed: %s\n", e.what());
+        sqlite3_close(db);
+        return 1;
+    }
+    sqlite3_close(db);
+    return 0;
+}
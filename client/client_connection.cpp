@@ -1,11 +1,25 @@
 #include "include/client_connection.h"
 #include <iostream>
+#include <algorithm>
+#include <future>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
 
 using json = nlohmann::json;
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+namespace {
+constexpr std::size_t kReadChunkSize = 8192;
+}
 
 ClientConnection::ClientConnection(boost::asio::io_context& io_context)
     : io_context_(io_context), resolver_(io_context), socket_(io_context),
-      connected_(false), receiving_(false) {}
+      connected_(false), receiving_(false), generation_(0),
+      write_framing_(FramingMode::Newline), payload_encoding_(PayloadEncoding::Json),
+      write_signal_(io_context) {}
 
 ClientConnection::~ClientConnection() {
     disconnect();
@@ -22,7 +36,14 @@ bool ClientConnection::connect(const std::string& host, const std::string& port)
         boost::asio::connect(socket_, endpoints, ec);
         
         if (!ec) {
+            // New connection starts from scratch: newline framing, empty buffers
+            read_buffer_ = FrameBuffer();
+            write_framing_ = FramingMode::Newline;
+            payload_encoding_ = PayloadEncoding::Json;
+            std::uint64_t generation = ++generation_;
             connected_ = true;
+
+            boost::asio::co_spawn(io_context_, writer(generation), boost::asio::detached);
             std::cout << "Connected successfully!" << std::endl;
             return true;
         } else {
@@ -35,22 +56,86 @@ bool ClientConnection::connect(const std::string& host, const std::string& port)
     }
 }
 
+bool ClientConnection::negotiateFraming(FramingMode mode, PayloadEncoding encoding) {
+    if (!connected_ || receiving_) {
+        handle_error("Framing must be negotiated right after connect");
+        return false;
+    }
+    if (encoding != PayloadEncoding::Json && mode != FramingMode::LengthPrefixed) {
+        handle_error("Binary encodings require length framing");
+        return false;
+    }
+
+    try {
+        json hello;
+        hello["type"] = "hello";
+        hello["framing"] = mode == FramingMode::LengthPrefixed ? "length" : "newline";
+        if (encoding != PayloadEncoding::Json) {
+            hello["encoding"] = encodingName(encoding);
+        }
+
+        // Циклы чтения еще не запущены, а writer простаивает - обмениваемся синхронно
+        boost::asio::write(socket_, boost::asio::buffer(encodeFrame(hello.dump())));
+
+        // Ответ на hello всегда приходит в newline-режиме; все, что пришло
+        // после него, остается в read_buffer_ для асинхронного чтения
+        std::string_view frame;
+        while (!read_buffer_.nextFrame(frame)) {
+            char* data = read_buffer_.prepare(kReadChunkSize);
+            read_buffer_.commit(socket_.read_some(boost::asio::buffer(data, read_buffer_.writable())));
+        }
+
+        json response = json::parse(frame);
+        if (response.value("type", "") != "hello_response" || !response.value("success", false)) {
+            handle_error("Framing negotiation rejected: " + response.value("message", std::string()));
+            return false;
+        }
+
+        read_buffer_.setMode(mode);
+        write_framing_ = mode;
+        payload_encoding_ = encoding;
+        std::cout << "Negotiated " << response.value("framing", std::string()) << " framing, "
+                  << encodingName(encoding) << " encoding" << std::endl;
+        return true;
+    } catch (const std::exception& e) {
+        handle_error("Framing negotiation error: " + std::string(e.what()));
+        return false;
+    }
+}
+
 void ClientConnection::disconnect() {
     if (connected_) {
         std::cout << "Disconnecting..." << std::endl;
         connected_ = false;
         receiving_ = false;
         
-        boost::system::error_code ec;
-        socket_.shutdown(tcp::socket::shutdown_both, ec);
-        socket_.close(ec);
+        // Сокет принадлежит io-потоку: закрываем его там и дожидаемся,
+        // чтобы последующий connect() не пересекся с закрытием
+        if (io_context_.stopped() || io_context_.get_executor().running_in_this_thread()) {
+            closeSocket();
+        } else {
+            std::promise<void> closed;
+            boost::asio::post(io_context_, [this, &closed]() {
+                closeSocket();
+                closed.set_value();
+            });
+            closed.get_future().wait();
+        }
     }
 }
 
+void ClientConnection::closeSocket() {
+    boost::system::error_code ec;
+    socket_.shutdown(tcp::socket::shutdown_both, ec);
+    socket_.close(ec);
+
+    write_queue_.clear();
+    write_signal_.cancel();
+}
+
 void ClientConnection::send(const nlohmann::json& message) {
     try {
-        std::string serialized = message.dump() + "\n";
-        send(serialized);
+        send(encodePayload(message, payload_encoding_));
     } catch (const std::exception& e) {
         handle_error("Error serializing message: " + std::string(e.what()));
     }
@@ -62,19 +147,25 @@ void ClientConnection::send(const std::string& raw_message) {
         return;
     }
 
-    try {
-        boost::system::error_code ec;
-        boost::asio::write(socket_, boost::asio::buffer(raw_message), ec);
-        
-        if (ec) {
-            handle_error("Send failed: " + ec.message());
-        } 
-        // else {
-        //     std::cout << "Sent: " << raw_message.substr(0, raw_message.length()-1) << std::endl; // Remove newline for display
-        // }
-    } catch (const std::exception& e) {
-        handle_error("Send error: " + std::string(e.what()));
+    // Очередь принадлежит io-потоку; UI-поток больше не блокируется на записи
+    boost::asio::post(io_context_, [this, frame = encodeFrame(raw_message)]() mutable {
+        write_queue_.push_back(std::move(frame));
+        write_signal_.cancel();
+    });
+}
+
+std::string ClientConnection::encodeFrame(const std::string& payload) const {
+    std::string frame;
+    if (write_framing_ == FramingMode::LengthPrefixed) {
+        frame.resize(FrameBuffer::kLengthPrefixSize);
+        FrameBuffer::encodeLengthPrefix(static_cast<std::uint32_t>(payload.size()), frame.data());
+        frame += payload;
+    } else {
+        frame.reserve(payload.size() + 1);
+        frame += payload;
+        frame += '\n';
     }
+    return frame;
 }
 
 void ClientConnection::startReceiving() {
@@ -87,7 +178,7 @@ void ClientConnection::startReceiving() {
     
     receiving_ = true;
     std::cout << "Started receiving messages..." << std::endl;
-    do_read();
+    boost::asio::co_spawn(io_context_, reader(generation_), boost::asio::detached);
 }
 
 void ClientConnection::stopReceiving() {
@@ -95,58 +186,76 @@ void ClientConnection::stopReceiving() {
     std::cout << "Stopped receiving messages." << std::endl;
 }
 
-void ClientConnection::do_read() {
-    if (!receiving_ || !connected_) {
-        std::cout << "Not reading - receiving_: " << receiving_ << ", connected_: " << connected_ << std::endl;
-        return;
-    }
+awaitable<void> ClientConnection::reader(std::uint64_t generation) {
+    try {
+        while (receiving_ && generation == generation_) {
+            std::size_t needed = std::max<std::size_t>(read_buffer_.bytesNeeded(), 1);
+            char* data = read_buffer_.prepare(std::max(needed, kReadChunkSize));
+            std::size_t length = co_await boost::asio::async_read(socket_,
+                boost::asio::buffer(data, read_buffer_.writable()),
+                boost::asio::transfer_at_least(needed), use_awaitable);
 
-    //std::cout << "Starting async_read_some..." << std::endl;
-    socket_.async_read_some(boost::asio::buffer(read_buffer_),
-        [this](boost::system::error_code ec, std::size_t length) {
-            //std::cout << "Read callback - ec: " << ec.message() << ", length: " << length << std::endl;
+            if (!receiving_) {
+                break;
+            }
+            read_buffer_.commit(length);
             
-            if (!ec && receiving_) {
-                // Append received data to message buffer
-                message_buffer_.append(read_buffer_.data(), length);
-                //std::cout << "Current buffer: '" << message_buffer_ << "'" << std::endl;
-                
-                // Process complete messages (separated by newline)
-                size_t pos = 0;
-                while ((pos = message_buffer_.find('\n')) != std::string::npos) {
-                    std::string complete_message = message_buffer_.substr(0, pos);
-                    message_buffer_.erase(0, pos + 1);
-                    
-                    //std::cout << "Processing complete message: '" << complete_message << "'" << std::endl;
-                    
-                    if (!complete_message.empty()) {
-                        handle_message(complete_message);
-                    }
-                }
-                
-                // Continue reading
-                do_read();
-            } else if (ec) {
-                if (receiving_) { // Only report error if we're still supposed to be receiving
-                    handle_error("Read failed: " + ec.message());
+            // Process complete messages in place
+            std::string_view complete_message;
+            while (read_buffer_.nextFrame(complete_message)) {
+                if (!complete_message.empty()) {
+                    handle_message(complete_message);
                 }
-                connected_ = false;
-                receiving_ = false;
             }
-        });
+        }
+    } catch (const boost::system::system_error& e) {
+        if (generation == generation_) {
+            if (receiving_) { // Only report error if we're still supposed to be receiving
+                handle_error("Read failed: " + e.code().message());
+            }
+            connected_ = false;
+            receiving_ = false;
+        }
+    }
+}
+
+awaitable<void> ClientConnection::writer(std::uint64_t generation) {
+    try {
+        while (connected_ && generation == generation_) {
+            if (write_queue_.empty()) {
+                boost::system::error_code ec;
+                write_signal_.expires_at(std::chrono::steady_clock::time_point::max());
+                co_await write_signal_.async_wait(boost::asio::redirect_error(use_awaitable, ec));
+                continue;
+            }
+
+            // Everything queued since the last write goes out in one gathered write
+            write_buffers_.clear();
+            for (const auto& frame : write_queue_) {
+                write_buffers_.push_back(boost::asio::buffer(frame));
+            }
+            std::size_t frames = write_queue_.size();
+            co_await boost::asio::async_write(socket_, write_buffers_, use_awaitable);
+            write_queue_.erase(write_queue_.begin(), write_queue_.begin() + frames);
+        }
+    } catch (const boost::system::system_error& e) {
+        if (generation == generation_ && connected_) {
+            handle_error("Send failed: " + e.code().message());
+        }
+    }
 }
 
-void ClientConnection::handle_message(const std::string& message) {
+void ClientConnection::handle_message(std::string_view message) {
     try {
         //std::cout << "Received: " << message << std::endl;
         
-        json parsed_message = json::parse(message);
+        json parsed_message = decodePayload(message, payload_encoding_);
         
         if (message_callback_) {
             message_callback_(parsed_message);
         }
     } catch (const json::parse_error& e) {
-        handle_error("JSON parse error: " + std::string(e.what()));
+        handle_error("Payload parse error: " + std::string(e.what()));
     } catch (const std::exception& e) {
         handle_error("Message handling error: " + std::string(e.what()));
     }
@@ -7,7 +7,7 @@
 using json = nlohmann::json;
 
 ClientStateMachine::ClientStateMachine(std::shared_ptr<ClientConnection> connection)
-    : current_state_(ClientState::Disconnected), connection_(connection) {
+    : current_state_(ClientState::Disconnected), connection_(connection), next_request_id_(1) {
     // MessageReceiver will be initialized later when needed
 }
 
@@ -37,10 +37,16 @@ std::string ClientStateMachine::getStateString() const {
     }
 }
 
-bool ClientStateMachine::tryConnect(const std::string& host, const std::string& port) {
+bool ClientStateMachine::tryConnect(const std::string& host, const std::string& port, PayloadEncoding encoding) {
     transitionToState(ClientState::TryConnect);
     
+    clearPendingRequests(); // Ответы на запросы прошлого соединения уже не придут
     bool connected = connection_->connect(host, port);
+    if (connected && encoding != PayloadEncoding::Json &&
+        !connection_->negotiateFraming(FramingMode::LengthPrefixed, encoding)) {
+        connection_->disconnect();
+        connected = false;
+    }
     
     if (connected) {
         transitionToState(ClientState::Connected);
@@ -65,6 +71,7 @@ bool ClientStateMachine::registerUser(const std::string& username, const std::st
     request["username"] = username;
     request["email"] = email;
     request["password"] = password;
+    trackRequest(request, Command::Register, username);
 
     connection_->send(request);
     
@@ -82,6 +89,8 @@ bool ClientStateMachine::loginUser(const std::string& username, const std::strin
     request["type"] = "login";
     request["username"] = username;
     request["password"] = password;
+    request["acks"] = true; // Подтверждаем доставку, неподтвержденное сервер пришлет снова
+    trackRequest(request, Command::Login, username);
 
     connection_->send(request);
     current_username_ = username; // Store for later use
@@ -98,6 +107,13 @@ void ClientStateMachine::startChat(const std::string& target_username) {
 
     chat_target_ = target_username;
     transitionToState(ClientState::Chatting);
+
+    // Сервер сообщит, когда собеседник войдет или выйдет
+    json subscribe;
+    subscribe["type"] = commandName(Command::Subscribe);
+    subscribe["users"] = json::array({chat_target_});
+    trackRequest(subscribe, Command::Subscribe, chat_target_);
+    connection_->send(subscribe);
 }
 
 void ClientStateMachine::sendMessage(const std::string& content) {
@@ -110,6 +126,7 @@ void ClientStateMachine::sendMessage(const std::string& content) {
     message["type"] = "message";
     message["to"] = chat_target_;
     message["content"] = content;
+    trackRequest(message, Command::Message, chat_target_);
 
     connection_->send(message);
 }
@@ -129,6 +146,12 @@ void ClientStateMachine::sendTypingStatus(bool is_typing) {
 
 void ClientStateMachine::exitChat() {
     if (current_state_ == ClientState::Chatting) {
+        json unsubscribe;
+        unsubscribe["type"] = commandName(Command::Unsubscribe);
+        unsubscribe["users"] = json::array({chat_target_});
+        trackRequest(unsubscribe, Command::Unsubscribe, chat_target_);
+        connection_->send(unsubscribe);
+
         chat_target_.clear();
         transitionToState(ClientState::Menu);
     }
@@ -143,6 +166,7 @@ void ClientStateMachine::logout() {
     }
     
     connection_->disconnect();
+    clearPendingRequests();
     transitionToState(ClientState::Disconnected);
 }
 
@@ -150,5 +174,34 @@ void ClientStateMachine::handleConnectionLost() {
     std::cerr << "Connection lost!" << std::endl;
     current_username_.clear();
     chat_target_.clear();
+    clearPendingRequests();
     transitionToState(ClientState::Disconnected);
 }
+
+void ClientStateMachine::trackRequest(json& request, Command command, std::string detail) {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    std::uint64_t id = next_request_id_++;
+    request["id"] = id;
+    pending_requests_.emplace(id, PendingRequest{command, std::move(detail)});
+}
+
+bool ClientStateMachine::completeRequest(std::uint64_t id, PendingRequest& request) {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    auto it = pending_requests_.find(id);
+    if (it == pending_requests_.end()) {
+        return false;
+    }
+    request = std::move(it->second);
+    pending_requests_.erase(it);
+    return true;
+}
+
+std::size_t ClientStateMachine::pendingRequestCount() const {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    return pending_requests_.size();
+}
+
+void ClientStateMachine::clearPendingRequests() {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_requests_.clear();
+}
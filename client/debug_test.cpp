@@ -4,13 +4,28 @@
 #include <memory>
 #include <thread>
 #include <chrono>
+#include <string>
 #include <nlohmann/json.hpp>
 #include "include/client_connection.h"
 
 using json = nlohmann::json;
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
+        // --length-framing: проверить length-prefixed режим (как у ботов)
+        // --msgpack / --cbor: бинарная кодировка поверх length-prefixed
+        bool length_framing = false;
+        PayloadEncoding encoding = PayloadEncoding::Json;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--length-framing") {
+                length_framing = true;
+            } else if (arg == "--msgpack" || arg == "--cbor") {
+                length_framing = true;
+                encoding = arg == "--msgpack" ? PayloadEncoding::MessagePack : PayloadEncoding::Cbor;
+            }
+        }
+
         std::cout << "=== CLIENT-SERVER COMMUNICATION TEST ===" << std::endl;
         
         boost::asio::io_context io_context;
@@ -41,6 +56,11 @@ int main() {
             return 1;
         }
         
+        if (length_framing && !connection->negotiateFraming(FramingMode::LengthPrefixed, encoding)) {
+            std::cerr << "Failed to negotiate framing!" << std::endl;
+            return 1;
+        }
+        
         // Start receiving
         connection->startReceiving();
         
@@ -4,9 +4,15 @@
 #include <boost/asio.hpp>
 #include <nlohmann/json.hpp>
 #include <memory>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
 #include <string>
-#include <array>
+#include <string_view>
 #include <functional>
+#include "frame_buffer.h"
+#include "payload_encoding.h"
 
 using boost::asio::ip::tcp;
 
@@ -23,9 +29,16 @@ public:
     void disconnect();
     bool isConnected() const { return connected_; }
 
-    // Message sending (async)
+    // Opt-in framing and body encoding negotiation ("hello" request). Synchronous;
+    // call right after connect() and before startReceiving(). Binary encodings
+    // (MessagePack, CBOR) require LengthPrefixed framing.
+    bool negotiateFraming(FramingMode mode, PayloadEncoding encoding = PayloadEncoding::Json);
+    FramingMode getFramingMode() const { return write_framing_; }
+    PayloadEncoding getPayloadEncoding() const { return payload_encoding_; }
+
+    // Message sending (async, safe to call from the UI thread)
     void send(const nlohmann::json& message);
-    void send(const std::string& raw_message);
+    void send(const std::string& raw_message); // Message already in the negotiated encoding, framing is added here
 
     // Message receiving (async)
     void startReceiving();
@@ -36,21 +49,32 @@ public:
     void setErrorCallback(ErrorCallback callback) { error_callback_ = callback; }
 
 private:
-    void do_read();
-    void handle_message(const std::string& message);
+    // Read/write loops; a coroutine exits once its connection generation is stale
+    boost::asio::awaitable<void> reader(std::uint64_t generation);
+    boost::asio::awaitable<void> writer(std::uint64_t generation);
+    std::string encodeFrame(const std::string& payload) const;
+    void closeSocket();
+    void handle_message(std::string_view message);
     void handle_error(const std::string& error);
 
     boost::asio::io_context& io_context_;
     tcp::resolver resolver_;
     tcp::socket socket_;
     
-    // State
-    bool connected_;
-    bool receiving_;
+    // State (checked from both the UI and the io thread)
+    std::atomic<bool> connected_;
+    std::atomic<bool> receiving_;
+    std::atomic<std::uint64_t> generation_; // Bumped on every successful connect
+    FramingMode write_framing_;
+    PayloadEncoding payload_encoding_;
 
     // Buffers
-    std::array<char, 8192> read_buffer_;
-    std::string message_buffer_; // For accumulating partial messages
+    FrameBuffer read_buffer_; // Accumulates partial messages, hands out whole frames
+
+    // Outbound queue, touched only on the io thread
+    std::deque<std::string> write_queue_;
+    std::vector<boost::asio::const_buffer> write_buffers_;
+    boost::asio::steady_timer write_signal_; // Cancelled to wake the writer
     
     // Callbacks
     MessageCallback message_callback_;
@@ -4,11 +4,23 @@
 #include <string>
 #include <memory>
 #include <functional>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "payload_encoding.h"
+#include "commands.h"
 
 // Forward declarations
 class ClientConnection;
 class MessageReceiver;
 
+// Request sent with an "id" whose *_response has not arrived yet
+struct PendingRequest {
+    Command command;
+    std::string detail; // What to tell the user if it fails (e.g. message recipient)
+};
+
 enum class ClientState {
     TryConnect,
     Disconnected,
@@ -31,7 +43,9 @@ public:
     std::string getStateString() const;
 
     // State-specific actions
-    bool tryConnect(const std::string& host, const std::string& port);
+    // A binary encoding is negotiated right after connect (with length framing)
+    bool tryConnect(const std::string& host, const std::string& port,
+                    PayloadEncoding encoding = PayloadEncoding::Json);
     bool registerUser(const std::string& username, const std::string& email, const std::string& password);
     bool loginUser(const std::string& username, const std::string& password);
     void startChat(const std::string& target_username);
@@ -40,6 +54,12 @@ public:
     void exitChat();
     void logout();
 
+    // Request pipelining: every request carries an id, so several can be in
+    // flight and responses are matched by id rather than by arrival order.
+    // Called from the io thread by MessageReceiver.
+    bool completeRequest(std::uint64_t id, PendingRequest& request);
+    std::size_t pendingRequestCount() const;
+
     // User info
     const std::string& getCurrentUsername() const { return current_username_; }
     const std::string& getChatTarget() const { return chat_target_; }
@@ -51,6 +71,8 @@ public:
 
 private:
     void handleConnectionLost();
+    void trackRequest(nlohmann::json& request, Command command, std::string detail = {});
+    void clearPendingRequests();
     
     ClientState current_state_;
     std::shared_ptr<ClientConnection> connection_;
@@ -59,6 +81,11 @@ private:
     // User session data
     std::string current_username_;
     std::string chat_target_;
+
+    // Requests awaiting a response, keyed by id
+    mutable std::mutex pending_mutex_;
+    std::uint64_t next_request_id_;
+    std::unordered_map<std::uint64_t, PendingRequest> pending_requests_;
 };
 
 #endif // CLIENT_STATE_MACHINE_H
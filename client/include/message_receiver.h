@@ -3,7 +3,12 @@
 
 #include <memory>
 #include <functional>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
 #include <nlohmann/json.hpp>
+#include "commands.h"
 
 // Forward declarations
 class ClientConnection;
@@ -34,12 +39,29 @@ private:
     void handleServerResponse(const nlohmann::json& response);
     void handleChatMessage(const nlohmann::json& message);
     void handleTypingStatus(const nlohmann::json& message);
+    void handlePresence(const nlohmann::json& message);
     void handleError(const nlohmann::json& error);
+    void handlePing(const nlohmann::json& message);
+    void handlePong(const nlohmann::json& message);
+    void resetIncomingStreams(const nlohmann::json& acked);
+    bool acceptDelivery(const std::string& from, std::int64_t seq);
+
+    // Delivery acks, per sender: everything up to `acked` has been received,
+    // `ahead` holds seqs past a gap (a redelivered message can arrive after newer live ones).
+    // Touched only from the io thread
+    struct IncomingStream {
+        std::int64_t acked = 0;
+        std::set<std::int64_t> ahead;
+    };
+    std::unordered_map<std::string, IncomingStream> incoming_streams_;
 
     std::shared_ptr<ClientConnection> connection_;
     std::shared_ptr<ClientStateMachine> state_machine_;
     
     bool listening_;
+
+    using Handler = void (MessageReceiver::*)(const nlohmann::json&);
+    CommandTable<Handler> handlers_; // Server responses share handleServerResponse
     
     // Callbacks
     MessageCallback message_callback_;
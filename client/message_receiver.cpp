@@ -7,7 +7,19 @@ using json = nlohmann::json;
 
 MessageReceiver::MessageReceiver(std::shared_ptr<ClientConnection> connection, 
                                 std::shared_ptr<ClientStateMachine> state_machine)
-    : connection_(connection), state_machine_(state_machine), listening_(false) {}
+    : connection_(connection), state_machine_(state_machine), listening_(false) {
+    for (std::size_t i = 0; i < kCommandCount; ++i) {
+        if (isResponse(static_cast<Command>(i))) {
+            handlers_.on(static_cast<Command>(i), &MessageReceiver::handleServerResponse);
+        }
+    }
+    handlers_.on(Command::Message, &MessageReceiver::handleChatMessage);
+    handlers_.on(Command::Typing, &MessageReceiver::handleTypingStatus);
+    handlers_.on(Command::Presence, &MessageReceiver::handlePresence);
+    handlers_.on(Command::Ping, &MessageReceiver::handlePing);
+    handlers_.on(Command::Pong, &MessageReceiver::handlePong);
+    handlers_.on(Command::Error, &MessageReceiver::handleError);
+}
 
 MessageReceiver::~MessageReceiver() {
     stopListening();
@@ -54,39 +66,51 @@ void MessageReceiver::handleIncomingMessage(const nlohmann::json& message) {
             return;
         }
         
-        std::string type = message["type"];
+        const std::string& type = message["type"].get_ref<const std::string&>();
         //std::cout << "MessageReceiver: Processing message type: " << type << std::endl;
         
-        if (type.length() > 9 && type.substr(type.length() - 9) == "_response") {
-            // Server responses (login_response, register_response, message_response)
-            handleServerResponse(message);
-        } else if (type == "message") {
-            // Chat messages from other users
-            handleChatMessage(message);
-        } else if (type == "typing") {
-            // Typing status updates
-            handleTypingStatus(message);
-        } else if (type == "error") {
-            // Error messages
-            handleError(message);
-        } else {
+        const Handler* handler = handlers_.find(commandFromName(type));
+        if (handler == nullptr) {
             std::cout << "MessageReceiver: Unknown message type: " << type << std::endl;
+            return;
         }
+        (this->**handler)(message);
         
     } catch (const std::exception& e) {
         std::cerr << "MessageReceiver error: " << e.what() << std::endl;
     }
 }
 
+void MessageReceiver::handlePing(const nlohmann::json&) {
+    // Heartbeat сервера - отвечаем, чтобы соединение не закрыли по простою
+    json pong;
+    pong["type"] = commandName(Command::Pong);
+    connection_->send(pong);
+}
+
+void MessageReceiver::handlePong(const nlohmann::json&) {
+    // Ответ на наш ping - ничего не делаем
+}
+
 void MessageReceiver::handleServerResponse(const nlohmann::json& response) {
-    std::string type = response["type"];
+    Command type = commandFromName(response["type"].get_ref<const std::string&>());
     bool success = response.value("success", false);
     std::string message = response.value("message", "");
+
+    // Ответы сопоставляем с запросами по id, а не по порядку прихода
+    PendingRequest request{Command::Unknown, {}};
+    auto id = response.find("id");
+    if (id != response.end() && id->is_number_unsigned() &&
+        !state_machine_->completeRequest(id->get<std::uint64_t>(), request)) {
+        std::cout << "MessageReceiver: Ignoring response to unknown request " << id->get<std::uint64_t>() << std::endl;
+        return;
+    }
     
-    //std::cout << "Server response - Type: " << type << ", Success: " << success << ", Message: " << message << std::endl;
+    //std::cout << "Server response - Type: " << commandName(type) << ", Success: " << success << ", Message: " << message << std::endl;
     
-    if (type == "login_response") {
+    if (type == Command::LoginResponse) {
         if (success) {
+            resetIncomingStreams(response.value("acked", json::object()));
             state_machine_->transitionToState(ClientState::LoggedIn);
             state_machine_->transitionToState(ClientState::Menu);
             std::cout << "✅ " << message << std::endl;
@@ -94,7 +118,7 @@ void MessageReceiver::handleServerResponse(const nlohmann::json& response) {
             std::cout << "❌ Login failed: " << message << std::endl;
             // Stay in AwaitingLogin state
         }
-    } else if (type == "register_response") {
+    } else if (type == Command::RegisterResponse) {
         if (success) {
             state_machine_->transitionToState(ClientState::Registered);
             // НЕ переходим в LoggedIn - пользователь должен залогиниться отдельно
@@ -106,22 +130,79 @@ void MessageReceiver::handleServerResponse(const nlohmann::json& response) {
             std::cout << "❌ Registration failed: " << message << std::endl;
             // Stay in AwaitingLogin state
         }
-    } else if (type == "message_response") {
+    } else if (type == Command::SubscribeResponse) {
+        if (success && request.command == Command::Subscribe) {
+            bool online = false;
+            for (const auto& user : response.value("online", json::array())) {
+                online = online || user == request.detail;
+            }
+            std::cout << (online ? "🟢 " : "⚪ ") << request.detail << (online ? " в сети" : " не в сети") << std::endl;
+        } else if (!success) {
+            std::cout << "❌ Presence subscription failed: " << message << std::endl;
+        }
+    } else if (type == Command::MessageResponse) {
         if (!success) {
-            std::cout << "❌ Message failed to send: " << message << std::endl;
+            if (request.command == Command::Message) {
+                std::cout << "❌ Message to " << request.detail << " failed to send: " << message << std::endl;
+            } else {
+                std::cout << "❌ Message failed to send: " << message << std::endl;
+            }
+        }
+    }
+}
+
+void MessageReceiver::resetIncomingStreams(const nlohmann::json& acked) {
+    incoming_streams_.clear();
+    if (!acked.is_object()) {
+        return;
+    }
+    for (auto it = acked.begin(); it != acked.end(); ++it) {
+        if (it.value().is_number_integer()) {
+            incoming_streams_[it.key()].acked = it.value().get<std::int64_t>();
         }
     }
 }
 
+bool MessageReceiver::acceptDelivery(const std::string& from, std::int64_t seq) {
+    IncomingStream& stream = incoming_streams_[from];
+    bool duplicate = seq <= stream.acked || !stream.ahead.insert(seq).second;
+
+    // Сдвигаем водяной знак по непрерывному префиксу
+    std::int64_t acked = stream.acked;
+    while (!stream.ahead.empty() && *stream.ahead.begin() == stream.acked + 1) {
+        stream.acked = *stream.ahead.begin();
+        stream.ahead.erase(stream.ahead.begin());
+    }
+
+    // Повтор тоже подтверждаем: значит, прошлый ack до сервера не дошел
+    if (stream.acked != acked || duplicate) {
+        json ack;
+        ack["type"] = commandName(Command::Ack);
+        ack["from"] = from;
+        ack["seq"] = stream.acked;
+        connection_->send(ack);
+    }
+    return !duplicate;
+}
+
 void MessageReceiver::handleChatMessage(const nlohmann::json& message) {
     if (message.contains("from") && message.contains("content")) {
         std::string from = message["from"];
+        auto seq = message.find("seq");
+        if (seq != message.end() && seq->is_number_unsigned() && !acceptDelivery(from, seq->get<std::int64_t>())) {
+            return; // Уже показано - это повторная доставка
+        }
         std::string content = message["content"];
         std::time_t timestamp = message.value("timestamp", std::time(nullptr));
         bool is_stored = message.value("stored", false);
         
         std::cout << "MessageReceiver: Received " << (is_stored ? "OFFLINE" : "LIVE") 
                   << " message from [" << from << "]: " << content << std::endl;
+        if (message.value("is_file", false)) {
+            // content - имя файла; скачивается запросом file_download по file_id
+            std::cout << "MessageReceiver: File [" << content << "] id " << message.value("file_id", std::string())
+                      << ", " << message.value("file_size", std::uint64_t{0}) << " bytes" << std::endl;
+        }
         
         if (message_callback_) {
             message_callback_(message);
@@ -159,6 +240,22 @@ void MessageReceiver::handleTypingStatus(const nlohmann::json& message) {
     }
 }
 
+void MessageReceiver::handlePresence(const nlohmann::json& message) {
+    // Сервер присылает только изменения с прошлого уведомления
+    for (const auto& user : message.value("online", json::array())) {
+        if (user.is_string()) {
+            std::cout << "\n🟢 " << user.get<std::string>() << " в сети" << std::endl;
+        }
+    }
+    for (const auto& user : message.value("offline", json::array())) {
+        if (user.is_string()) {
+            std::cout << "\n⚪ " << user.get<std::string>() << " вышел из сети" << std::endl;
+        }
+    }
+    std::cout << "> ";
+    std::cout.flush();
+}
+
 void MessageReceiver::handleError(const nlohmann::json& error) {
     std::string message = error.value("message", "Unknown error");
     std::cerr << "❌ Server error: " << message << std::endl;
@@ -0,0 +1,85 @@
+#include "include/base64.h"
+#include <array>
+#include <cstdint>
+
+namespace {
+constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+constexpr std::array<std::int8_t, 256> buildDecodeTable() {
+    std::array<std::int8_t, 256> table{};
+    table.fill(-1);
+    for (int i = 0; i < 64; ++i) {
+        table[static_cast<unsigned char>(kAlphabet[i])] = static_cast<std::int8_t>(i);
+    }
+    return table;
+}
+
+constexpr auto kDecodeTable = buildDecodeTable();
+}
+
+std::string base64Encode(std::string_view data) {
+    std::string out;
+    out.reserve((data.size() + 2) / 3 * 4);
+
+    std::size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        std::uint32_t chunk = (static_cast<unsigned char>(data[i]) << 16) |
+                              (static_cast<unsigned char>(data[i + 1]) << 8) |
+                              static_cast<unsigned char>(data[i + 2]);
+        out += kAlphabet[(chunk >> 18) & 0x3F];
+        out += kAlphabet[(chunk >> 12) & 0x3F];
+        out += kAlphabet[(chunk >> 6) & 0x3F];
+        out += kAlphabet[chunk & 0x3F];
+    }
+
+    std::size_t rest = data.size() - i;
+    if (rest > 0) {
+        std::uint32_t chunk = static_cast<unsigned char>(data[i]) << 16;
+        if (rest == 2) {
+            chunk |= static_cast<unsigned char>(data[i + 1]) << 8;
+        }
+        out += kAlphabet[(chunk >> 18) & 0x3F];
+        out += kAlphabet[(chunk >> 12) & 0x3F];
+        out += rest == 2 ? kAlphabet[(chunk >> 6) & 0x3F] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+bool base64Decode(std::string_view text, std::string& out) {
+    out.clear();
+    if (text.size() % 4 != 0) {
+        return false;
+    }
+    out.reserve(text.size() / 4 * 3);
+
+    for (std::size_t i = 0; i < text.size(); i += 4) {
+        // '=' допустим только в конце последней четверки
+        bool last = i + 4 == text.size();
+        std::size_t padding = 0;
+        if (last && text[i + 3] == '=') {
+            padding = text[i + 2] == '=' ? 2 : 1;
+        }
+
+        std::uint32_t chunk = 0;
+        for (std::size_t j = 0; j < 4; ++j) {
+            std::int8_t value = 0;
+            if (j < 4 - padding) {
+                value = kDecodeTable[static_cast<unsigned char>(text[i + j])];
+                if (value < 0) {
+                    return false;
+                }
+            }
+            chunk = (chunk << 6) | static_cast<std::uint32_t>(value);
+        }
+
+        out += static_cast<char>((chunk >> 16) & 0xFF);
+        if (padding < 2) {
+            out += static_cast<char>((chunk >> 8) & 0xFF);
+        }
+        if (padding < 1) {
+            out += static_cast<char>(chunk & 0xFF);
+        }
+    }
+    return true;
+}
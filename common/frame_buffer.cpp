@@ -0,0 +1,109 @@
+#include "frame_buffer.h"
+#include <algorithm>
+#include <cstring>
+
+FrameBuffer::FrameBuffer(std::size_t initial_capacity)
+    : mode_(FramingMode::Newline), max_frame_size_(0), oversized_(false), storage_(initial_capacity), read_pos_(0), scan_pos_(0), write_pos_(0) {}
+
+char* FrameBuffer::prepare(std::size_t min_size) {
+    if (read_pos_ == write_pos_) {
+        // Everything consumed - start from the beginning without moving data
+        read_pos_ = scan_pos_ = write_pos_ = 0;
+    }
+
+    if (writable() < min_size && read_pos_ > 0) {
+        compact();
+    }
+
+    if (writable() < min_size) {
+        storage_.resize(std::max(storage_.size() * 2, write_pos_ + min_size));
+    }
+
+    return storage_.data() + write_pos_;
+}
+
+void FrameBuffer::commit(std::size_t n) {
+    write_pos_ = std::min(write_pos_ + n, storage_.size());
+}
+
+bool FrameBuffer::nextFrame(std::string_view& frame) {
+    if (oversized_) {
+        return false;
+    }
+    if (mode_ == FramingMode::LengthPrefixed) {
+        return nextLengthPrefixedFrame(frame);
+    }
+    return nextDelimitedFrame(frame);
+}
+
+std::size_t FrameBuffer::bytesNeeded() const {
+    if (mode_ != FramingMode::LengthPrefixed || oversized_) {
+        return 0;
+    }
+    if (size() < kLengthPrefixSize) {
+        return kLengthPrefixSize - size();
+    }
+    std::size_t frame_size = kLengthPrefixSize + pendingPayloadLength();
+    return frame_size > size() ? frame_size - size() : 0;
+}
+
+void FrameBuffer::encodeLengthPrefix(std::uint32_t length, char* out) {
+    out[0] = static_cast<char>((length >> 24) & 0xFF);
+    out[1] = static_cast<char>((length >> 16) & 0xFF);
+    out[2] = static_cast<char>((length >> 8) & 0xFF);
+    out[3] = static_cast<char>(length & 0xFF);
+}
+
+bool FrameBuffer::nextDelimitedFrame(std::string_view& frame) {
+    const char* base = storage_.data();
+    const void* delimiter = std::memchr(base + scan_pos_, '\n', write_pos_ - scan_pos_);
+
+    if (delimiter == nullptr) {
+        // Remember how far we scanned so the next call only looks at new bytes
+        scan_pos_ = write_pos_;
+        oversized_ = exceedsLimit(size());
+        return false;
+    }
+
+    std::size_t end = static_cast<const char*>(delimiter) - base;
+    if (exceedsLimit(end - read_pos_)) {
+        oversized_ = true;
+        return false;
+    }
+    frame = std::string_view(base + read_pos_, end - read_pos_);
+    read_pos_ = scan_pos_ = end + 1;
+    return true;
+}
+
+bool FrameBuffer::nextLengthPrefixedFrame(std::string_view& frame) {
+    // Длина известна из префикса - отказываем до того, как придет payload
+    if (size() >= kLengthPrefixSize && exceedsLimit(pendingPayloadLength())) {
+        oversized_ = true;
+        return false;
+    }
+    if (bytesNeeded() != 0) {
+        return false;
+    }
+
+    std::size_t length = pendingPayloadLength();
+    frame = std::string_view(storage_.data() + read_pos_ + kLengthPrefixSize, length);
+    read_pos_ += kLengthPrefixSize + length;
+    scan_pos_ = read_pos_;
+    return true;
+}
+
+std::uint32_t FrameBuffer::pendingPayloadLength() const {
+    const auto* prefix = reinterpret_cast<const unsigned char*>(storage_.data() + read_pos_);
+    return (static_cast<std::uint32_t>(prefix[0]) << 24) |
+           (static_cast<std::uint32_t>(prefix[1]) << 16) |
+           (static_cast<std::uint32_t>(prefix[2]) << 8) |
+           static_cast<std::uint32_t>(prefix[3]);
+}
+
+void FrameBuffer::compact() {
+    std::size_t remaining = size();
+    std::memmove(storage_.data(), storage_.data() + read_pos_, remaining);
+    scan_pos_ -= read_pos_;
+    read_pos_ = 0;
+    write_pos_ = remaining;
+}
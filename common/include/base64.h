@@ -0,0 +1,19 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Standard base64 (RFC 4648, with padding) for binary data inside JSON frames,
+// e.g. file chunks on connections without length-prefixed framing
+std::string base64Encode(std::string_view data);
+// False on characters outside the alphabet or a malformed length
+bool base64Decode(std::string_view text, std::string& out);
+
+// Largest raw chunk whose base64 form fits in `encoded_limit` bytes
+constexpr std::size_t base64DecodedLimit(std::size_t encoded_limit) {
+    return encoded_limit / 4 * 3;
+}
+
+#endif // BASE64_H
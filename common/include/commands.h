@@ -0,0 +1,176 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Every message "type" of the protocol, shared by the server and the client.
+// Adding a command means adding an enumerator and its name below; the lookup
+// table is rebuilt at compile time.
+enum class Command : std::uint8_t {
+    Unknown,
+    Hello,
+    Register,
+    Login,
+    Message,
+    Typing,
+    Ping,
+    Pong,
+    Ack,
+    Subscribe,
+    Unsubscribe,
+    Presence,
+    FileUpload,
+    FileChunk,
+    FileDownload,
+    FileData,
+    Error,
+    HelloResponse,
+    RegisterResponse,
+    LoginResponse,
+    MessageResponse,
+    ErrorResponse,
+    SubscribeResponse,
+    UnsubscribeResponse,
+    FileUploadResponse,
+    FileChunkResponse,
+    FileDownloadResponse,
+    Count
+};
+
+constexpr std::size_t kCommandCount = static_cast<std::size_t>(Command::Count);
+
+// Indexed by Command
+inline constexpr std::array<std::string_view, kCommandCount> kCommandNames = {
+    "",
+    "hello",
+    "register",
+    "login",
+    "message",
+    "typing",
+    "ping",
+    "pong",
+    "ack",
+    "subscribe",
+    "unsubscribe",
+    "presence",
+    "file_upload",
+    "file_chunk",
+    "file_download",
+    "file_data",
+    "error",
+    "hello_response",
+    "register_response",
+    "login_response",
+    "message_response",
+    "error_response",
+    "subscribe_response",
+    "unsubscribe_response",
+    "file_upload_response",
+    "file_chunk_response",
+    "file_download_response",
+};
+
+constexpr std::string_view commandName(Command command) {
+    return kCommandNames[static_cast<std::size_t>(command)];
+}
+
+// Reply type the server uses for a request ("login" -> "login_response")
+constexpr Command responseFor(Command request) {
+    switch (request) {
+        case Command::Hello: return Command::HelloResponse;
+        case Command::Register: return Command::RegisterResponse;
+        case Command::Login: return Command::LoginResponse;
+        case Command::Message: return Command::MessageResponse;
+        case Command::Error: return Command::ErrorResponse;
+        case Command::Subscribe: return Command::SubscribeResponse;
+        case Command::Unsubscribe: return Command::UnsubscribeResponse;
+        case Command::FileUpload: return Command::FileUploadResponse;
+        case Command::FileChunk: return Command::FileChunkResponse;
+        case Command::FileDownload: return Command::FileDownloadResponse;
+        default: return Command::Unknown;
+    }
+}
+
+constexpr bool isResponse(Command command) {
+    return command >= Command::HelloResponse && command < Command::Count;
+}
+
+namespace command_detail {
+
+constexpr std::size_t kTableSize = 64; // Power of two, comfortably above kCommandCount
+
+constexpr std::uint32_t hash(std::string_view name, std::uint32_t seed) {
+    std::uint32_t h = 2166136261u ^ seed; // FNV-1a
+    for (char c : name) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+struct Table {
+    std::uint32_t seed;
+    std::array<Command, kTableSize> slots;
+};
+
+// Перебираем seed, пока все имена не лягут в разные слоты - идеальный хеш
+constexpr Table build() {
+    for (std::uint32_t seed = 0; seed < 10000; ++seed) {
+        Table table{seed, {}};
+        table.slots.fill(Command::Unknown);
+        bool collision = false;
+        for (std::size_t i = 1; i < kCommandCount && !collision; ++i) {
+            Command& slot = table.slots[hash(kCommandNames[i], seed) & (kTableSize - 1)];
+            collision = slot != Command::Unknown;
+            slot = static_cast<Command>(i);
+        }
+        if (!collision) {
+            return table;
+        }
+    }
+    return Table{0, {}};
+}
+
+inline constexpr Table kTable = build();
+
+} // namespace command_detail
+
+// One hash and one string compare, no comparison chain
+constexpr Command commandFromName(std::string_view name) {
+    Command command = command_detail::kTable.slots[
+        command_detail::hash(name, command_detail::kTable.seed) & (command_detail::kTableSize - 1)];
+    return commandName(command) == name ? command : Command::Unknown;
+}
+
+namespace command_detail {
+constexpr bool roundTrips() {
+    for (std::size_t i = 1; i < kCommandCount; ++i) {
+        if (commandFromName(kCommandNames[i]) != static_cast<Command>(i)) {
+            return false;
+        }
+    }
+    return commandFromName("") == Command::Unknown;
+}
+static_assert(roundTrips(), "command name table has no perfect hash; grow kTableSize");
+} // namespace command_detail
+
+// Handlers registered once per command; dispatch is an array index
+template <typename Handler>
+class CommandTable {
+public:
+    void on(Command command, Handler handler) { handlers_[static_cast<std::size_t>(command)] = handler; }
+
+    // nullptr when nothing is registered for the command
+    const Handler* find(Command command) const {
+        const Handler& handler = handlers_[static_cast<std::size_t>(command)];
+        return handler ? &handler : nullptr;
+    }
+
+private:
+    std::array<Handler, kCommandCount> handlers_{};
+};
+
+#endif // COMMANDS_H
@@ -0,0 +1,77 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Wire framing of a connection. Every connection starts in Newline mode;
+// LengthPrefixed is negotiated with a "hello" request right after connect.
+enum class FramingMode {
+    Newline,        // JSON text terminated by '\n'
+    LengthPrefixed  // 4-byte big-endian payload length, then the payload
+};
+
+// Reusable receive buffer that splits the stream into frames.
+// Socket reads land directly in the buffer (prepare/commit) and complete frames
+// are handed out as views, so nothing is copied or shifted per frame.
+class FrameBuffer {
+public:
+    static constexpr std::size_t kLengthPrefixSize = 4;
+
+    explicit FrameBuffer(std::size_t initial_capacity = 8192);
+
+    // Switching applies to the bytes that have not been returned as frames yet
+    void setMode(FramingMode mode) { mode_ = mode; }
+    FramingMode mode() const { return mode_; }
+
+    // Largest accepted frame payload, 0 = unlimited. The limit is checked while
+    // bytes arrive: an unterminated line or a length prefix above it marks the
+    // buffer oversized before the rest of the frame is buffered.
+    void setMaxFrameSize(std::size_t max_frame_size) { max_frame_size_ = max_frame_size; }
+    std::size_t maxFrameSize() const { return max_frame_size_; }
+
+    // Sticky: once set, nextFrame() returns no more frames
+    bool oversized() const { return oversized_; }
+
+    // Returns a writable region of at least min_size bytes at the tail.
+    // Invalidates previously returned frame views.
+    char* prepare(std::size_t min_size);
+    std::size_t writable() const { return storage_.size() - write_pos_; }
+
+    // Marks n bytes written into the prepared region as received
+    void commit(std::size_t n);
+
+    // Extracts the next complete frame (without the delimiter).
+    // The view stays valid until the next prepare() call.
+    bool nextFrame(std::string_view& frame);
+
+    // Bytes received but not yet returned as frames
+    std::size_t size() const { return write_pos_ - read_pos_; }
+
+    // Bytes still missing to complete the pending frame. Only known in
+    // LengthPrefixed mode; returns 0 in Newline mode.
+    std::size_t bytesNeeded() const;
+
+    static void encodeLengthPrefix(std::uint32_t length, char* out);
+
+private:
+    bool nextDelimitedFrame(std::string_view& frame);
+    bool nextLengthPrefixedFrame(std::string_view& frame);
+    std::uint32_t pendingPayloadLength() const;
+    void compact();
+
+    bool exceedsLimit(std::size_t frame_size) const { return max_frame_size_ != 0 && frame_size > max_frame_size_; }
+
+    FramingMode mode_;
+    std::size_t max_frame_size_;
+    bool oversized_;
+
+    std::vector<char> storage_;
+    std::size_t read_pos_;   // Start of the first unconsumed byte
+    std::size_t scan_pos_;   // Bytes before this position hold no delimiter
+    std::size_t write_pos_;  // End of received data
+};
+
+#endif // FRAME_BUFFER_H
@@ -0,0 +1,26 @@
+#ifndef PAYLOAD_ENCODING_H
+#define PAYLOAD_ENCODING_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+
+// Body encoding of a connection, negotiated in "hello" together with the framing.
+// Binary encodings contain arbitrary bytes, so they require LengthPrefixed framing.
+enum class PayloadEncoding {
+    Json,
+    MessagePack,
+    Cbor
+};
+
+constexpr std::size_t kPayloadEncodingCount = 3;
+
+std::string_view encodingName(PayloadEncoding encoding);
+bool parseEncodingName(std::string_view name, PayloadEncoding& encoding);
+
+// Invalid UTF-8 in strings is replaced in JSON output instead of throwing
+std::string encodePayload(const nlohmann::json& message, PayloadEncoding encoding);
+// Throws nlohmann::json::parse_error on malformed input, including strings that are not UTF-8
+nlohmann::json decodePayload(std::string_view payload, PayloadEncoding encoding);
+
+#endif // PAYLOAD_ENCODING_H
@@ -0,0 +1,9 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <string_view>
+
+// Same acceptance rules as nlohmann: no overlong forms, no surrogates, max U+10FFFF
+bool isValidUtf8(std::string_view text);
+
+#endif // UTF8_H
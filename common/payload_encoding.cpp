@@ -0,0 +1,91 @@
+#include "payload_encoding.h"
+#include "utf8.h"
+
+using json = nlohmann::json;
+
+namespace {
+// JSON text is validated by the parser itself; msgpack/cbor strings are raw bytes
+bool hasOnlyUtf8Strings(const json& value) {
+    switch (value.type()) {
+        case json::value_t::string:
+            return isValidUtf8(value.get_ref<const std::string&>());
+        case json::value_t::object:
+            for (const auto& [key, item] : value.items()) {
+                if (!isValidUtf8(key) || !hasOnlyUtf8Strings(item)) {
+                    return false;
+                }
+            }
+            return true;
+        case json::value_t::array:
+            for (const auto& item : value) {
+                if (!hasOnlyUtf8Strings(item)) {
+                    return false;
+                }
+            }
+            return true;
+        default:
+            return true;
+    }
+}
+}
+
+std::string_view encodingName(PayloadEncoding encoding) {
+    switch (encoding) {
+        case PayloadEncoding::MessagePack: return "msgpack";
+        case PayloadEncoding::Cbor: return "cbor";
+        case PayloadEncoding::Json: break;
+    }
+    return "json";
+}
+
+bool parseEncodingName(std::string_view name, PayloadEncoding& encoding) {
+    if (name == "json") {
+        encoding = PayloadEncoding::Json;
+    } else if (name == "msgpack") {
+        encoding = PayloadEncoding::MessagePack;
+    } else if (name == "cbor") {
+        encoding = PayloadEncoding::Cbor;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string encodePayload(const json& message, PayloadEncoding encoding) {
+    std::string payload;
+    // Пишем сразу в строку, без промежуточного std::vector<uint8_t>
+    switch (encoding) {
+        case PayloadEncoding::MessagePack:
+            json::to_msgpack(message, nlohmann::detail::output_adapter<char>(payload));
+            break;
+        case PayloadEncoding::Cbor:
+            json::to_cbor(message, nlohmann::detail::output_adapter<char>(payload));
+            break;
+        case PayloadEncoding::Json:
+            // Невалидный UTF-8 не должен ронять отправку: заменяем на U+FFFD
+            payload = message.dump(-1, ' ', false, json::error_handler_t::replace);
+            break;
+    }
+    return payload;
+}
+
+json decodePayload(std::string_view payload, PayloadEncoding encoding) {
+    const char* begin = payload.data();
+    const char* end = payload.data() + payload.size();
+    json message;
+    switch (encoding) {
+        case PayloadEncoding::MessagePack:
+            message = json::from_msgpack(begin, end);
+            break;
+        case PayloadEncoding::Cbor:
+            message = json::from_cbor(begin, end);
+            break;
+        case PayloadEncoding::Json:
+            return json::parse(begin, end);
+    }
+    // Строка не в UTF-8 ушла бы дальше и сломала JSON-получателей
+    if (!hasOnlyUtf8Strings(message)) {
+        throw json::parse_error::create(113, 0, "string is not valid UTF-8", nullptr);
+    }
+    return message;
+}
@@ -0,0 +1,45 @@
+#include "utf8.h"
+
+bool isValidUtf8(std::string_view text) {
+    std::size_t i = 0;
+    while (i < text.size()) {
+        auto c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+
+        std::size_t length;
+        unsigned char min_next = 0x80;
+        unsigned char max_next = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            length = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            length = 3;
+            if (c == 0xE0) min_next = 0xA0;
+            if (c == 0xED) max_next = 0x9F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            length = 4;
+            if (c == 0xF0) min_next = 0x90;
+            if (c == 0xF4) max_next = 0x8F;
+        } else {
+            return false;
+        }
+
+        if (i + length > text.size()) {
+            return false;
+        }
+        auto next = static_cast<unsigned char>(text[i + 1]);
+        if (next < min_next || next > max_next) {
+            return false;
+        }
+        for (std::size_t k = 2; k < length; ++k) {
+            auto continuation = static_cast<unsigned char>(text[i + k]);
+            if (continuation < 0x80 || continuation > 0xBF) {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
@@ -1,242 +1,501 @@
 #include "include/database.h"
+#include "include/schema_migrations.h"
 #include <ctime>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 
-void Database::initialize() {
-    // Create users table
-    const char* users_sql = 
-        "CREATE TABLE IF NOT EXISTS users ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "username TEXT NOT NULL UNIQUE,"
-        "email TEXT NOT NULL UNIQUE,"
-        "password_hash TEXT NOT NULL,"
-        "created_at DATETIME DEFAULT CURRENT_TIMESTAMP);";
-
-    // Create messages table
-    const char* messages_sql = 
-        "CREATE TABLE IF NOT EXISTS messages ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "sender_id INTEGER NOT NULL,"
-        "receiver_id INTEGER NOT NULL,"
-        "content TEXT NOT NULL,"
-        "sent_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
-        "is_file BOOLEAN DEFAULT FALSE,"
-        "file_path TEXT,"
-        "is_delivered BOOLEAN DEFAULT FALSE,"
-        "FOREIGN KEY(sender_id) REFERENCES users(id),"
-        "FOREIGN KEY(receiver_id) REFERENCES users(id));";
-
+namespace {
+// Runs a PRAGMA/DDL statement, throwing on failure; returns the first column of the last row, if any
+std::string execOrThrow(sqlite3* db, const std::string& sql) {
+    std::string result;
     char* err_msg = nullptr;
-    
-    // Execute users table creation
-    if (sqlite3_exec(db_, users_sql, 0, 0, &err_msg) != SQLITE_OK) {
-        std::string error = "SQL error on users table creation: ";
-        error += err_msg;
+    auto capture = [](void* out, int columns, char** values, char**) {
+        if (columns > 0 && values[0] != nullptr) {
+            *static_cast<std::string*>(out) = values[0];
+        }
+        return 0;
+    };
+    if (sqlite3_exec(db, sql.c_str(), capture, &result, &err_msg) != SQLITE_OK) {
+        std::string error = "SQL error on \"" + sql + "\": ";
+        error += err_msg ? err_msg : sqlite3_errmsg(db);
         sqlite3_free(err_msg);
         throw std::runtime_error(error);
     }
-    
-    // Execute messages table creation
-    if (sqlite3_exec(db_, messages_sql, 0, 0, &err_msg) != SQLITE_OK) {
-        std::string error = "SQL error on messages table creation: ";
-        error += err_msg;
-        sqlite3_free(err_msg);
-        throw std::runtime_error(error);
+    return result;
+}
+
+// Pragmas every connection gets (the page cache and mmap are per connection)
+void applyConnectionPragmas(sqlite3* db, const DatabaseSettings& settings) {
+    sqlite3_busy_timeout(db, static_cast<int>(settings.busy_timeout.count()));
+    // Отрицательное значение cache_size задается в KiB, а не в страницах
+    execOrThrow(db, "PRAGMA cache_size = -" + std::to_string(settings.cache_size_kib) + ";");
+    execOrThrow(db, "PRAGMA mmap_size = " + std::to_string(settings.mmap_size) + ";");
+}
+
+std::unique_ptr<User> readUser(sqlite3_stmt* stmt) {
+    auto user = std::make_unique<User>();
+    user->id = sqlite3_column_int(stmt, 0);
+    user->username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    user->email = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+    user->password_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+    user->created_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+    return user;
+}
+
+Message readMessage(sqlite3_stmt* stmt) {
+    Message msg;
+    msg.id = sqlite3_column_int64(stmt, 0);
+    msg.sender_id = sqlite3_column_int(stmt, 1);
+    msg.receiver_id = sqlite3_column_int(stmt, 2);
+    msg.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+    msg.sent_at = sqlite3_column_int64(stmt, 4);
+    msg.is_file = sqlite3_column_int(stmt, 5) != 0;
+
+    const char* file_path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
+    msg.file_path = file_path ? file_path : "";
+    msg.is_delivered = sqlite3_column_int(stmt, 7) != 0;
+    msg.seq = sqlite3_column_int64(stmt, 8);
+    return msg;
+}
+
+FileRecord readFile(sqlite3_stmt* stmt) {
+    FileRecord file;
+    file.id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    file.sender_id = sqlite3_column_int(stmt, 1);
+    file.receiver_id = sqlite3_column_int(stmt, 2);
+    file.name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+    file.size = static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 4));
+    file.created_at = sqlite3_column_int64(stmt, 5);
+    file.complete = sqlite3_column_int(stmt, 6) != 0;
+    return file;
+}
+
+// Binds one row of the messages INSERT
+void bindMessage(sqlite3_stmt* stmt, const NewMessage& message) {
+    sqlite3_bind_int(stmt, 1, message.sender_id);
+    sqlite3_bind_int(stmt, 2, message.receiver_id);
+    sqlite3_bind_text(stmt, 3, message.content.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, message.sent_at);
+    sqlite3_bind_int64(stmt, 5, message.seq);
+    sqlite3_bind_int(stmt, 6, message.is_file ? 1 : 0);
+    sqlite3_bind_text(stmt, 7, message.file_path.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 8, message.is_delivered ? 1 : 0);
+}
+}
+
+std::int64_t messageTimestampNow() {
+    static std::atomic<std::int64_t> last{0};
+    std::int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    // Часы могут отскочить назад (NTP) - тогда держим последнее выданное значение
+    std::int64_t previous = last.load(std::memory_order_relaxed);
+    while (previous < now && !last.compare_exchange_weak(previous, now, std::memory_order_relaxed)) {
     }
-    
-    std::cout << "Database tables initialized successfully." << std::endl;
+    return std::max(previous, now);
 }
 
-bool Database::addUser(const std::string& username, const std::string& email, const std::string& password_hash) {
-    const char* sql = "INSERT INTO users (username, email, password_hash) VALUES (?, ?, ?);";
+void Database::initialize(const DatabaseSettings& settings) {
+    // WAL: читатели не блокируют писателя и наоборот; synchronous=NORMAL в WAL
+    // не теряет целостность, только последние транзакции при сбое питания
+    std::string journal_mode = execOrThrow(db_, "PRAGMA journal_mode = WAL;");
+    if (journal_mode != "wal") {
+        throw std::runtime_error("Can't switch database to WAL mode (journal_mode=" + journal_mode + ")");
+    }
+    execOrThrow(db_, "PRAGMA synchronous = " + settings.synchronous + ";");
+    applyConnectionPragmas(db_, settings);
+
+    int schema_version = applyMigrations(db_);
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db_) << std::endl;
-        return false;
+    prepareStatements();
+    LOG_INFO("database tables initialized", "schema_version", schema_version,
+             "journal_mode", journal_mode, "synchronous", settings.synchronous);
+}
+
+void Database::prepareStatements() {
+    statements_ = std::make_unique<Statements>();
+    statements_->add_user = PreparedStatement(db_,
+        "INSERT INTO users (username, email, password_hash) VALUES (?, ?, ?);");
+    statements_->store_message = PreparedStatement(db_,
+        "INSERT INTO messages (sender_id, receiver_id, content, sent_at, seq, is_file, file_path, is_delivered) VALUES (?, ?, ?, ?, ?, ?, ?, ?);");
+    // is_delivered = 0 литералом: иначе частичный индекс idx_messages_undelivered не подходит
+    statements_->select_offline_page = PreparedStatement(db_,
+        "SELECT id, sender_id, receiver_id, content, sent_at, is_file, file_path, is_delivered, seq FROM messages "
+        "WHERE receiver_id = ? AND is_delivered = 0 AND id > ? ORDER BY id LIMIT ?;");
+    statements_->mark_offline_delivered = PreparedStatement(db_,
+        "UPDATE messages SET is_delivered = 1 WHERE receiver_id = ? AND is_delivered = 0 AND id > ? AND id <= ?;");
+    // Водяной знак только растет: запоздавший ack с меньшим seq ничего не меняет
+    statements_->raise_ack_watermark = PreparedStatement(db_,
+        "INSERT INTO delivery_acks (receiver_id, sender_id, acked_seq) VALUES (?, ?, ?) "
+        "ON CONFLICT (receiver_id, sender_id) DO UPDATE SET acked_seq = MAX(acked_seq, excluded.acked_seq);");
+    statements_->mark_acked_delivered = PreparedStatement(db_,
+        "UPDATE messages SET is_delivered = 1 WHERE receiver_id = ? AND is_delivered = 0 AND sender_id = ? AND seq <= ?;");
+    // Без ack'ов строки помечаются доставленными напрямую; водяной знак идет
+    // следом, иначе клиент с ack'ами при следующем входе увидит дыру в потоке
+    statements_->sync_ack_watermark = PreparedStatement(db_,
+        "INSERT INTO delivery_acks (receiver_id, sender_id, acked_seq) "
+        "SELECT ?1, ?2, COALESCE("
+        "(SELECT MIN(seq) - 1 FROM messages WHERE receiver_id = ?1 AND is_delivered = 0 AND sender_id = ?2), "
+        "(SELECT MAX(seq) FROM messages WHERE sender_id = ?2 AND receiver_id = ?1), 0) WHERE true "
+        "ON CONFLICT (receiver_id, sender_id) DO UPDATE SET acked_seq = MAX(acked_seq, excluded.acked_seq);");
+    statements_->add_file = PreparedStatement(db_,
+        "INSERT INTO files (id, sender_id, receiver_id, name, size, created_at) VALUES (?, ?, ?, ?, ?, ?);");
+    statements_->complete_file = PreparedStatement(db_,
+        "UPDATE files SET completed_at = ? WHERE id = ? AND completed_at IS NULL;");
+    statements_->remove_unfinished_file = PreparedStatement(db_,
+        "DELETE FROM files WHERE id = ? AND completed_at IS NULL;");
+    statements_->begin = PreparedStatement(db_, "BEGIN IMMEDIATE;");
+    statements_->commit = PreparedStatement(db_, "COMMIT;");
+    statements_->rollback = PreparedStatement(db_, "ROLLBACK;");
+}
+
+void Database::openReaders(const std::string& db_path, const DatabaseSettings& settings) {
+    if (settings.reader_connections == 0) {
+        throw std::invalid_argument("Database needs at least one reader connection");
+    }
+    // Таблицы уже созданы писателем, читатели открываются только на чтение
+    for (std::size_t i = 0; i < settings.reader_connections; ++i) {
+        readers_.push_back(std::make_unique<ReaderConnection>(db_path, settings));
+        idle_readers_.push_back(readers_.back().get());
     }
+    LOG_INFO("database reader pool opened", "connections", readers_.size());
+}
+
+bool Database::isValidSynchronousMode(const std::string& mode) {
+    return mode == "OFF" || mode == "NORMAL" || mode == "FULL" || mode == "EXTRA";
+}
+
+Database::ReaderConnection::ReaderConnection(const std::string& db_path, const DatabaseSettings& settings)
+    : db(db_path, SQLITE_OPEN_READONLY) {
+    applyConnectionPragmas(db, settings);
+    get_user = PreparedStatement(db,
+        "SELECT id, username, email, password_hash, created_at FROM users WHERE username = ?;");
+    get_user_by_id = PreparedStatement(db,
+        "SELECT id, username, email, password_hash, created_at FROM users WHERE id = ?;");
+    last_sequence = PreparedStatement(db,
+        "SELECT COALESCE(MAX(seq), 0) FROM messages WHERE sender_id = ? AND receiver_id = ?;");
+    get_ack_watermarks = PreparedStatement(db,
+        "SELECT users.username, delivery_acks.acked_seq FROM delivery_acks "
+        "JOIN users ON users.id = delivery_acks.sender_id WHERE delivery_acks.receiver_id = ?;");
+    get_file = PreparedStatement(db,
+        "SELECT id, sender_id, receiver_id, name, size, created_at, completed_at IS NOT NULL FROM files WHERE id = ?;");
+    get_upload_usage = PreparedStatement(db,
+        "SELECT COUNT(*), COALESCE(SUM(size), 0) FROM files WHERE sender_id = ? AND completed_at IS NULL;");
+    get_unfinished_files = PreparedStatement(db,
+        "SELECT id, sender_id, receiver_id, name, size, created_at, 0 FROM files WHERE completed_at IS NULL;");
+}
+
+Database::ReaderLease::ReaderLease(Database& database) : database_(database) {
+    std::unique_lock<std::mutex> lock(database_.readers_mutex_);
+    database_.reader_released_.wait(lock, [this]() { return !database_.idle_readers_.empty(); });
+    reader_ = database_.idle_readers_.back();
+    database_.idle_readers_.pop_back();
+}
+
+Database::ReaderLease::~ReaderLease() {
+    {
+        std::lock_guard<std::mutex> lock(database_.readers_mutex_);
+        database_.idle_readers_.push_back(reader_);
+    }
+    database_.reader_released_.notify_one();
+}
+
+bool Database::addUser(const std::string& username, const std::string& email, const std::string& password_hash) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StatementScope stmt(statements_->add_user);
     
     sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, email.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 3, password_hash.c_str(), -1, SQLITE_STATIC);
     
-    int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    
-    if (result == SQLITE_DONE) {
-        std::cout << "User " << username << " registered successfully." << std::endl;
+    if (sqlite3_step(stmt) == SQLITE_DONE) {
+        LOG_DEBUG("user row inserted", "user", username);
         return true;
     } else {
-        std::cerr << "Failed to register user: " << sqlite3_errmsg(db_) << std::endl;
+        LOG_WARN("failed to insert user", "user", username, "error", sqlite3_errmsg(db_));
         return false;
     }
 }
 
 std::unique_ptr<User> Database::getUser(const std::string& username) {
-    const char* sql = "SELECT id, username, email, password_hash, created_at FROM users WHERE username = ?;";
-    
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db_) << std::endl;
-        return nullptr;
-    }
+    ReaderLease reader(*this);
+    StatementScope stmt(reader->get_user);
     
     sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
     
-    std::unique_ptr<User> user = nullptr;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        user = std::make_unique<User>();
-        user->id = sqlite3_column_int(stmt, 0);
-        user->username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        user->email = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        user->password_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        user->created_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+        return readUser(stmt);
     }
-    
-    sqlite3_finalize(stmt);
-    return user;
+    return nullptr;
 }
 
 std::unique_ptr<User> Database::getUserById(int user_id) {
-    const char* sql = "SELECT id, username, email, password_hash, created_at FROM users WHERE id = ?;";
-    
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db_) << std::endl;
-        return nullptr;
-    }
+    ReaderLease reader(*this);
+    StatementScope stmt(reader->get_user_by_id);
     
     sqlite3_bind_int(stmt, 1, user_id);
     
-    std::unique_ptr<User> user = nullptr;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        user = std::make_unique<User>();
-        user->id = sqlite3_column_int(stmt, 0);
-        user->username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        user->email = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        user->password_hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        user->created_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+        return readUser(stmt);
     }
-    
-    sqlite3_finalize(stmt);
-    return user;
+    return nullptr;
 }
 
-bool Database::storeMessage(int sender_id, int receiver_id, const std::string& content, bool is_delivered, bool is_file, const std::string& file_path) {
-    const char* sql = "INSERT INTO messages (sender_id, receiver_id, content, is_file, file_path, is_delivered) VALUES (?, ?, ?, ?, ?, ?);";
-    
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db_) << std::endl;
+bool Database::commitBatch(const std::vector<NewMessage>& messages, const std::vector<DeliveryAck>& acks) {
+    if (messages.empty() && acks.empty()) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    {
+        StatementScope begin(statements_->begin);
+        if (sqlite3_step(begin) != SQLITE_DONE) {
+            LOG_ERROR("failed to begin transaction", "error", sqlite3_errmsg(db_));
+            return false;
+        }
+    }
+
+    bool ok = true;
+    for (const auto& message : messages) {
+        StatementScope stmt(statements_->store_message);
+        bindMessage(stmt, message);
+
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            LOG_ERROR("failed to insert message", "sender_id", message.sender_id,
+                      "receiver_id", message.receiver_id, "error", sqlite3_errmsg(db_));
+            ok = false;
+            break;
+        }
+    }
+
+    // Ack'и идут после вставок: подтверждение может прийти на сообщение из этой же пачки
+    for (std::size_t i = 0; ok && i < acks.size(); ++i) {
+        const DeliveryAck& ack = acks[i];
+        StatementScope watermark(statements_->raise_ack_watermark);
+        sqlite3_bind_int(watermark, 1, ack.receiver_id);
+        sqlite3_bind_int(watermark, 2, ack.sender_id);
+        sqlite3_bind_int64(watermark, 3, ack.seq);
+
+        StatementScope mark(statements_->mark_acked_delivered);
+        sqlite3_bind_int(mark, 1, ack.receiver_id);
+        sqlite3_bind_int(mark, 2, ack.sender_id);
+        sqlite3_bind_int64(mark, 3, ack.seq);
+
+        if (sqlite3_step(watermark) != SQLITE_DONE || sqlite3_step(mark) != SQLITE_DONE) {
+            LOG_ERROR("failed to apply delivery ack", "receiver_id", ack.receiver_id,
+                      "sender_id", ack.sender_id, "error", sqlite3_errmsg(db_));
+            ok = false;
+        }
+    }
+
+    // Строки, вставленные сразу доставленными (клиент без ack'ов), двигают водяной знак
+    std::vector<std::pair<int, int>> delivered_streams;
+    for (const auto& message : messages) {
+        if (message.is_delivered) {
+            delivered_streams.emplace_back(message.receiver_id, message.sender_id);
+        }
+    }
+    std::sort(delivered_streams.begin(), delivered_streams.end());
+    delivered_streams.erase(std::unique(delivered_streams.begin(), delivered_streams.end()), delivered_streams.end());
+    for (std::size_t i = 0; ok && i < delivered_streams.size(); ++i) {
+        ok = syncAckWatermark(delivered_streams[i].first, delivered_streams[i].second);
+    }
+
+    if (ok) {
+        StatementScope commit(statements_->commit);
+        if (sqlite3_step(commit) == SQLITE_DONE) {
+            return true;
+        }
+        LOG_ERROR("failed to commit transaction", "error", sqlite3_errmsg(db_));
+    }
+
+    StatementScope rollback(statements_->rollback);
+    sqlite3_step(rollback);
+    return false;
+}
+
+bool Database::syncAckWatermark(int receiver_id, int sender_id) {
+    StatementScope stmt(statements_->sync_ack_watermark);
+    sqlite3_bind_int(stmt, 1, receiver_id);
+    sqlite3_bind_int(stmt, 2, sender_id);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        LOG_ERROR("failed to sync delivery watermark", "receiver_id", receiver_id,
+                  "sender_id", sender_id, "error", sqlite3_errmsg(db_));
         return false;
     }
-    
+    return true;
+}
+
+bool Database::readOfflineMessages(int user_id, std::int64_t after_id, std::size_t limit,
+                                   std::vector<Message>& page) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StatementScope select(statements_->select_offline_page);
+    sqlite3_bind_int(select, 1, user_id);
+    sqlite3_bind_int64(select, 2, after_id);
+    sqlite3_bind_int64(select, 3, static_cast<sqlite3_int64>(limit));
+
+    std::size_t first = page.size();
+    int result;
+    while ((result = sqlite3_step(select)) == SQLITE_ROW) {
+        page.push_back(readMessage(select));
+    }
+    if (result != SQLITE_DONE) {
+        LOG_ERROR("failed to read offline messages", "user_id", user_id, "error", sqlite3_errmsg(db_));
+        page.resize(first);
+        return false;
+    }
+    return true;
+}
+
+bool Database::markOfflineDelivered(int user_id, std::int64_t after_id, std::int64_t last_id,
+                                    const std::vector<int>& sender_ids) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    {
+        StatementScope begin(statements_->begin);
+        if (sqlite3_step(begin) != SQLITE_DONE) {
+            LOG_ERROR("failed to begin transaction", "error", sqlite3_errmsg(db_));
+            return false;
+        }
+    }
+
+    bool ok = true;
+    {
+        // Помечаем ровно отправленный диапазон id
+        StatementScope mark(statements_->mark_offline_delivered);
+        sqlite3_bind_int(mark, 1, user_id);
+        sqlite3_bind_int64(mark, 2, after_id);
+        sqlite3_bind_int64(mark, 3, last_id);
+        if (sqlite3_step(mark) != SQLITE_DONE) {
+            LOG_ERROR("failed to mark offline messages delivered", "user_id", user_id, "error", sqlite3_errmsg(db_));
+            ok = false;
+        }
+    }
+    for (std::size_t i = 0; ok && i < sender_ids.size(); ++i) {
+        ok = syncAckWatermark(user_id, sender_ids[i]);
+    }
+
+    if (ok) {
+        StatementScope commit(statements_->commit);
+        if (sqlite3_step(commit) == SQLITE_DONE) {
+            return true;
+        }
+        LOG_ERROR("failed to commit transaction", "error", sqlite3_errmsg(db_));
+    }
+
+    StatementScope rollback(statements_->rollback);
+    sqlite3_step(rollback);
+    return false;
+}
+
+std::int64_t Database::lastSequence(int sender_id, int receiver_id) {
+    ReaderLease reader(*this);
+    StatementScope stmt(reader->last_sequence);
+
     sqlite3_bind_int(stmt, 1, sender_id);
     sqlite3_bind_int(stmt, 2, receiver_id);
-    sqlite3_bind_text(stmt, 3, content.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 4, is_file ? 1 : 0);
-    sqlite3_bind_text(stmt, 5, file_path.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 6, is_delivered ? 1 : 0);
-    
-    int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    
-    return result == SQLITE_DONE;
-}
 
-std::vector<Message> Database::getMessages(int user_id, int other_user_id, int limit) {
-    const char* sql = "SELECT id, sender_id, receiver_id, content, sent_at, is_file, file_path, is_delivered FROM messages "
-                      "WHERE (sender_id = ? AND receiver_id = ?) OR (sender_id = ? AND receiver_id = ?) "
-                      "ORDER BY sent_at DESC LIMIT ?;";
-    
-    sqlite3_stmt* stmt;
-    std::vector<Message> messages;
-    
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db_) << std::endl;
-        return messages;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        return sqlite3_column_int64(stmt, 0);
     }
-    
-    sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_int(stmt, 2, other_user_id);
-    sqlite3_bind_int(stmt, 3, other_user_id);
-    sqlite3_bind_int(stmt, 4, user_id);
-    sqlite3_bind_int(stmt, 5, limit);
-    
+    LOG_ERROR("failed to read last sequence", "sender_id", sender_id, "receiver_id", receiver_id,
+              "error", sqlite3_errmsg(reader->db));
+    throw std::runtime_error("Can't read message sequence");
+}
+
+std::vector<AckWatermark> Database::getAckWatermarks(int receiver_id) {
+    ReaderLease reader(*this);
+    StatementScope stmt(reader->get_ack_watermarks);
+    std::vector<AckWatermark> watermarks;
+
+    sqlite3_bind_int(stmt, 1, receiver_id);
+
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Message msg;
-        msg.id = sqlite3_column_int(stmt, 0);
-        msg.sender_id = sqlite3_column_int(stmt, 1);
-        msg.receiver_id = sqlite3_column_int(stmt, 2);
-        msg.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        msg.sent_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        msg.is_file = sqlite3_column_int(stmt, 5) != 0;
-        
-        const char* file_path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-        msg.file_path = file_path ? file_path : "";
-        msg.is_delivered = sqlite3_column_int(stmt, 7) != 0;
-        
-        messages.push_back(msg);
+        watermarks.push_back(AckWatermark{reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+                                          sqlite3_column_int64(stmt, 1)});
     }
-    
-    sqlite3_finalize(stmt);
-    return messages;
+    return watermarks;
 }
 
-std::vector<Message> Database::getOfflineMessages(int user_id) {
-    const char* sql = "SELECT id, sender_id, receiver_id, content, sent_at, is_file, file_path, is_delivered FROM messages "
-                      "WHERE receiver_id = ? AND is_delivered = 0 ORDER BY sent_at ASC;";
-    
-    sqlite3_stmt* stmt;
-    std::vector<Message> messages;
-    
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db_) << std::endl;
-        return messages;
+bool Database::addFile(const FileRecord& file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StatementScope stmt(statements_->add_file);
+
+    sqlite3_bind_text(stmt, 1, file.id.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, file.sender_id);
+    sqlite3_bind_int(stmt, 3, file.receiver_id);
+    sqlite3_bind_text(stmt, 4, file.name.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 5, static_cast<sqlite3_int64>(file.size));
+    sqlite3_bind_int64(stmt, 6, file.created_at);
+
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        LOG_WARN("failed to insert file", "file_id", file.id, "error", sqlite3_errmsg(db_));
+        return false;
     }
-    
-    sqlite3_bind_int(stmt, 1, user_id);
-    
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Message msg;
-        msg.id = sqlite3_column_int(stmt, 0);
-        msg.sender_id = sqlite3_column_int(stmt, 1);
-        msg.receiver_id = sqlite3_column_int(stmt, 2);
-        msg.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        msg.sent_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        msg.is_file = sqlite3_column_int(stmt, 5) != 0;
-        
-        const char* file_path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-        msg.file_path = file_path ? file_path : "";
-        msg.is_delivered = sqlite3_column_int(stmt, 7) != 0;
-        
-        messages.push_back(msg);
+    return true;
+}
+
+std::unique_ptr<FileRecord> Database::getFile(const std::string& file_id) {
+    ReaderLease reader(*this);
+    StatementScope stmt(reader->get_file);
+
+    sqlite3_bind_text(stmt, 1, file_id.c_str(), -1, SQLITE_STATIC);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        return nullptr;
     }
-    
-    sqlite3_finalize(stmt);
-    return messages;
+    return std::make_unique<FileRecord>(readFile(stmt));
 }
 
-bool Database::deleteOfflineMessages(int user_id) {
-    const char* sql = "DELETE FROM messages WHERE receiver_id = ? AND is_delivered = 0;";
-    
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db_) << std::endl;
+bool Database::completeFile(const std::string& file_id, std::int64_t completed_at) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StatementScope stmt(statements_->complete_file);
+
+    sqlite3_bind_int64(stmt, 1, completed_at);
+    sqlite3_bind_text(stmt, 2, file_id.c_str(), -1, SQLITE_STATIC);
+
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        LOG_WARN("failed to complete file", "file_id", file_id, "error", sqlite3_errmsg(db_));
         return false;
     }
-    
-    sqlite3_bind_int(stmt, 1, user_id);
-    
-    int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    
-    if (result == SQLITE_DONE) {
-        std::cout << "Deleted offline messages for user ID: " << user_id << std::endl;
-        return true;
-    } else {
-        std::cerr << "Failed to delete offline messages: " << sqlite3_errmsg(db_) << std::endl;
+    return sqlite3_changes(db_) > 0;
+}
+
+UploadUsage Database::getUploadUsage(int sender_id) {
+    ReaderLease reader(*this);
+    StatementScope stmt(reader->get_upload_usage);
+
+    sqlite3_bind_int(stmt, 1, sender_id);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        LOG_ERROR("failed to read upload usage", "sender_id", sender_id, "error", sqlite3_errmsg(reader->db));
+        throw std::runtime_error("Can't read upload usage");
+    }
+    return UploadUsage{static_cast<std::size_t>(sqlite3_column_int64(stmt, 0)),
+                       static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 1))};
+}
+
+std::vector<FileRecord> Database::getUnfinishedFiles() {
+    ReaderLease reader(*this);
+    StatementScope stmt(reader->get_unfinished_files);
+    std::vector<FileRecord> files;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        files.push_back(readFile(stmt));
+    }
+    return files;
+}
+
+bool Database::removeUnfinishedFile(const std::string& file_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StatementScope stmt(statements_->remove_unfinished_file);
+
+    sqlite3_bind_text(stmt, 1, file_id.c_str(), -1, SQLITE_STATIC);
+
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        LOG_WARN("failed to remove unfinished file", "file_id", file_id, "error", sqlite3_errmsg(db_));
         return false;
     }
+    return sqlite3_changes(db_) > 0;
 }
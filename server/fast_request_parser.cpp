@@ -0,0 +1,255 @@
+#include "include/fast_request_parser.h"
+#include "commands.h"
+#include "utf8.h"
+
+namespace {
+constexpr unsigned bit(int field) { return 1u << field; }
+}
+
+FastRequest FastRequestParser::parse(std::string_view frame) {
+    input_ = frame;
+    pos_ = 0;
+    present_ = 0;
+    scratch_.clear();
+
+    if (!parseObject()) {
+        return std::monostate{};
+    }
+
+    // Только точный набор полей: лишние ключи обрабатывает DOM-путь
+    switch (commandFromName(strings_[kType])) {
+        case Command::Message:
+            if (hasExactly(bit(kType) | bit(kTo) | bit(kContent))) {
+                return ChatMessageRequest{strings_[kTo], strings_[kContent], id()};
+            }
+            break;
+        case Command::Typing:
+            if (hasExactly(bit(kType) | bit(kTo) | bit(kIsTyping))) {
+                return TypingRequest{strings_[kTo], is_typing_, id()};
+            }
+            break;
+        case Command::Login:
+            if (hasExactly(bit(kType) | bit(kUsername) | bit(kPassword)) ||
+                hasExactly(bit(kType) | bit(kUsername) | bit(kPassword) | bit(kAcks))) {
+                return LoginRequest{strings_[kUsername], strings_[kPassword], id(), has(kAcks) && acks_};
+            }
+            break;
+        case Command::Register:
+            if (hasExactly(bit(kType) | bit(kUsername) | bit(kEmail) | bit(kPassword))) {
+                return RegisterRequest{strings_[kUsername], strings_[kEmail], strings_[kPassword], id()};
+            }
+            break;
+        case Command::Ack:
+            if (hasExactly(bit(kType) | bit(kFrom) | bit(kSeq))) {
+                return AckRequest{strings_[kFrom], seq_, id()};
+            }
+            break;
+        default:
+            break;
+    }
+    return std::monostate{};
+}
+
+bool FastRequestParser::parseObject() {
+    skipWhitespace();
+    if (pos_ >= input_.size() || input_[pos_] != '{') {
+        return false;
+    }
+    ++pos_;
+
+    skipWhitespace();
+    if (pos_ < input_.size() && input_[pos_] == '}') {
+        return false; // Пустой объект - пусть разбирается DOM
+    }
+
+    for (;;) {
+        skipWhitespace();
+        std::string_view key;
+        if (!parseString(key)) {
+            return false;
+        }
+
+        Field field;
+        if (key == "type") field = kType;
+        else if (key == "to") field = kTo;
+        else if (key == "content") field = kContent;
+        else if (key == "is_typing") field = kIsTyping;
+        else if (key == "username") field = kUsername;
+        else if (key == "email") field = kEmail;
+        else if (key == "password") field = kPassword;
+        else if (key == "id") field = kId;
+        else if (key == "from") field = kFrom;
+        else if (key == "seq") field = kSeq;
+        else if (key == "acks") field = kAcks;
+        else return false;
+
+        if (has(field)) {
+            return false;
+        }
+
+        skipWhitespace();
+        if (pos_ >= input_.size() || input_[pos_] != ':') {
+            return false;
+        }
+        ++pos_;
+        skipWhitespace();
+
+        bool parsed;
+        if (field == kIsTyping) {
+            parsed = parseBool(is_typing_);
+        } else if (field == kAcks) {
+            parsed = parseBool(acks_);
+        } else if (field == kId) {
+            parsed = parseUnsigned(id_);
+        } else if (field == kSeq) {
+            parsed = parseUnsigned(seq_);
+        } else {
+            parsed = parseString(strings_[field]);
+        }
+        if (!parsed) {
+            return false;
+        }
+        present_ |= bit(field);
+
+        skipWhitespace();
+        if (pos_ >= input_.size()) {
+            return false;
+        }
+        if (input_[pos_] == ',') {
+            ++pos_;
+            continue;
+        }
+        if (input_[pos_] != '}') {
+            return false;
+        }
+        ++pos_;
+        break;
+    }
+
+    skipWhitespace();
+    return pos_ == input_.size();
+}
+
+bool FastRequestParser::parseString(std::string_view& out) {
+    if (pos_ >= input_.size() || input_[pos_] != '"') {
+        return false;
+    }
+    std::size_t start = ++pos_;
+    bool ascii = true;
+
+    // Быстрый проход: большинство строк без escape-последовательностей
+    while (pos_ < input_.size()) {
+        auto c = static_cast<unsigned char>(input_[pos_]);
+        if (c == '"') {
+            out = input_.substr(start, pos_ - start);
+            ++pos_;
+            return ascii || isValidUtf8(out);
+        }
+        if (c == '\\') {
+            break;
+        }
+        if (c < 0x20) {
+            return false;
+        }
+        ascii = ascii && c < 0x80;
+        ++pos_;
+    }
+    if (pos_ >= input_.size()) {
+        return false;
+    }
+
+    // Декодированная строка не длиннее исходной, поэтому одного reserve хватает
+    // и ранее выданные view не инвалидируются
+    if (scratch_.capacity() < input_.size()) {
+        if (!scratch_.empty()) {
+            return false;
+        }
+        scratch_.reserve(input_.size());
+    }
+    std::size_t decoded_start = scratch_.size();
+    scratch_.append(input_.substr(start, pos_ - start));
+
+    while (pos_ < input_.size()) {
+        auto c = static_cast<unsigned char>(input_[pos_]);
+        if (c == '"') {
+            ++pos_;
+            out = std::string_view(scratch_).substr(decoded_start);
+            return ascii || isValidUtf8(out);
+        }
+        if (c < 0x20) {
+            return false;
+        }
+        if (c != '\\') {
+            ascii = ascii && c < 0x80;
+            scratch_ += static_cast<char>(c);
+            ++pos_;
+            continue;
+        }
+
+        if (++pos_ >= input_.size()) {
+            return false;
+        }
+        switch (input_[pos_]) {
+            case '"': scratch_ += '"'; break;
+            case '\\': scratch_ += '\\'; break;
+            case '/': scratch_ += '/'; break;
+            case 'b': scratch_ += '\b'; break;
+            case 'f': scratch_ += '\f'; break;
+            case 'n': scratch_ += '\n'; break;
+            case 'r': scratch_ += '\r'; break;
+            case 't': scratch_ += '\t'; break;
+            default: return false; // \uXXXX и ошибки - через DOM
+        }
+        ++pos_;
+    }
+    return false;
+}
+
+bool FastRequestParser::parseBool(bool& out) {
+    std::string_view rest = input_.substr(pos_);
+    if (rest.substr(0, 4) == "true") {
+        out = true;
+        pos_ += 4;
+        return true;
+    }
+    if (rest.substr(0, 5) == "false") {
+        out = false;
+        pos_ += 5;
+        return true;
+    }
+    return false;
+}
+
+bool FastRequestParser::parseUnsigned(std::uint64_t& out) {
+    std::size_t start = pos_;
+    std::uint64_t value = 0;
+    while (pos_ < input_.size() && input_[pos_] >= '0' && input_[pos_] <= '9') {
+        auto digit = static_cast<std::uint64_t>(input_[pos_] - '0');
+        if (value > (UINT64_MAX - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+        ++pos_;
+    }
+
+    std::size_t digits = pos_ - start;
+    if (digits == 0 || (digits > 1 && input_[start] == '0')) {
+        return false;
+    }
+    // Дробные и экспоненциальные числа - через DOM
+    if (pos_ < input_.size() && (input_[pos_] == '.' || input_[pos_] == 'e' || input_[pos_] == 'E')) {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+void FastRequestParser::skipWhitespace() {
+    while (pos_ < input_.size()) {
+        char c = input_[pos_];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            break;
+        }
+        ++pos_;
+    }
+}
@@ -0,0 +1,268 @@
+#include "include/file_store.h"
+#include "include/logger.h"
+#include "base64.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <system_error>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr std::size_t kIdLength = 32; // 128 бит в hex
+constexpr std::size_t kChunkFrameOverhead = 512; // Остальные поля file_chunk
+}
+
+std::shared_ptr<const BlobFile> BlobFile::open(const std::filesystem::path& path) {
+#ifdef _WIN32
+    int fd = ::_wopen(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    if (fd < 0) {
+        return nullptr;
+    }
+    return std::shared_ptr<const BlobFile>(new BlobFile(fd));
+}
+
+BlobFile::~BlobFile() {
+#ifdef _WIN32
+    ::_close(fd_);
+#else
+    ::close(fd_);
+#endif
+}
+
+bool BlobFile::read(std::uint64_t offset, std::size_t length, std::string& out) const {
+    out.resize(length);
+    std::size_t done = 0;
+    while (done < length) {
+#ifdef _WIN32
+        // Один download читает свой blob последовательно, общей позиции ни с кем не делим
+        if (::_lseeki64(fd_, static_cast<__int64>(offset + done), SEEK_SET) < 0) {
+            return false;
+        }
+        int n = ::_read(fd_, out.data() + done, static_cast<unsigned int>(length - done));
+#else
+        ssize_t n = ::pread(fd_, out.data() + done, length - done, static_cast<off_t>(offset + done));
+#endif
+        if (n <= 0) {
+            return false; // Файл короче ожидаемого или ошибка чтения
+        }
+        done += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+FileStore::FileStore(Database& db, TimingWheel& timing_wheel, const FileTransferSettings& settings,
+                     std::size_t max_frame_size)
+    : db_(db), timing_wheel_(timing_wheel), settings_(settings), max_frame_size_(max_frame_size),
+      blob_dir_(settings.blob_dir) {
+    std::filesystem::create_directories(blob_dir_);
+    LOG_INFO("blob directory ready", "path", blob_dir_.string());
+    removeStaleUploads(); // Брошенные до перезапуска
+    scheduleCleanup();
+}
+
+FileStore::~FileStore() {
+    timing_wheel_.cancel(cleanup_timer_);
+}
+
+std::size_t FileStore::uploadChunkSize(PayloadEncoding encoding) const {
+    std::size_t room = max_frame_size_ > 2 * kChunkFrameOverhead ? max_frame_size_ - kChunkFrameOverhead
+                                                                 : max_frame_size_ / 2;
+    // В JSON байты идут в base64, в MessagePack/CBOR - как есть
+    return encoding == PayloadEncoding::Json ? base64DecodedLimit(room) : room;
+}
+
+FileStore::CreateResult FileStore::createUpload(int sender_id, int receiver_id, std::string name, std::uint64_t size,
+                                               FileRecord& file) {
+    std::lock_guard<std::mutex> lock(create_mutex_);
+    UploadUsage usage = db_.getUploadUsage(sender_id);
+    if (usage.count >= settings_.max_open_uploads) {
+        return CreateResult::TooManyUploads;
+    }
+    if (size > settings_.max_pending_bytes || usage.bytes > settings_.max_pending_bytes - size) {
+        return CreateResult::QuotaExceeded;
+    }
+
+    file = FileRecord{generateId(), sender_id, receiver_id, std::move(name), size, messageTimestampNow(), false};
+    if (!db_.addFile(file)) {
+        return CreateResult::Failed;
+    }
+    LOG_INFO("upload started", "file_id", file.id, "sender_id", sender_id, "receiver_id", receiver_id, "size", size);
+    return CreateResult::Created;
+}
+
+std::unique_ptr<FileRecord> FileStore::find(const std::string& file_id) {
+    if (!isValidId(file_id)) {
+        return nullptr;
+    }
+    return db_.getFile(file_id);
+}
+
+std::uint64_t FileStore::receivedBytes(const FileRecord& file) {
+    if (file.complete) {
+        return file.size;
+    }
+    std::error_code ec;
+    auto size = std::filesystem::file_size(partPath(file.id), ec);
+    return ec ? 0 : static_cast<std::uint64_t>(size);
+}
+
+FileStore::ChunkResult FileStore::appendChunk(FileRecord& file, std::uint64_t offset, std::string_view data,
+                                              std::uint64_t& received) {
+    auto upload_mutex = uploadMutex(file.id);
+    std::lock_guard<std::mutex> lock(*upload_mutex);
+
+    if (file.complete) {
+        received = file.size;
+        return ChunkResult::WrongOffset;
+    }
+    received = receivedBytes(file);
+    if (offset != received) {
+        return ChunkResult::WrongOffset; // Повтор или пропуск: клиент продолжит с received
+    }
+    if (data.size() > file.size - received) {
+        return ChunkResult::TooLarge;
+    }
+    if (received == 0 && db_.getFile(file.id) == nullptr) {
+        return ChunkResult::UnknownFile; // Удалена чисткой, пока чанк шел к нам
+    }
+
+    {
+        std::ofstream part(partPath(file.id), std::ios::binary | std::ios::app);
+        part.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!part) {
+            LOG_ERROR("failed to write upload chunk", "file_id", file.id, "offset", offset);
+            return ChunkResult::Failed;
+        }
+    }
+    received += data.size();
+    if (received < file.size) {
+        return ChunkResult::Accepted;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(partPath(file.id), blobPath(file.id), ec);
+    if (ec || !db_.completeFile(file.id, messageTimestampNow())) {
+        LOG_ERROR("failed to complete upload", "file_id", file.id, "error", ec.message());
+        return ChunkResult::Failed;
+    }
+    file.complete = true;
+    LOG_INFO("upload complete", "file_id", file.id, "size", file.size);
+    return ChunkResult::Completed;
+}
+
+std::shared_ptr<const BlobFile> FileStore::openBlob(const FileRecord& file) {
+    if (!file.complete || !isValidId(file.id)) {
+        return nullptr;
+    }
+    return BlobFile::open(blobPath(file.id));
+}
+
+std::shared_ptr<std::mutex> FileStore::uploadMutex(const std::string& file_id) {
+    std::lock_guard<std::mutex> lock(upload_locks_mutex_);
+    auto& entry = upload_locks_[file_id];
+    auto mutex = entry.lock();
+    if (!mutex) {
+        mutex = std::make_shared<std::mutex>();
+        entry = mutex;
+    }
+
+    // Мьютексы закончившихся загрузок выбрасываем, когда их накопится вдвое больше живых
+    if (upload_locks_.size() >= prune_locks_at_) {
+        for (auto it = upload_locks_.begin(); it != upload_locks_.end();) {
+            it = it->second.expired() ? upload_locks_.erase(it) : std::next(it);
+        }
+        prune_locks_at_ = std::max(kMinLocksToPrune, upload_locks_.size() * 2);
+    }
+    return mutex;
+}
+
+void FileStore::scheduleCleanup() {
+    timing_wheel_.schedule(cleanup_timer_, settings_.cleanup_interval, [this]() {
+        removeStaleUploads();
+        scheduleCleanup();
+    });
+}
+
+void FileStore::removeStaleUploads() {
+    try {
+        auto now_ms = messageTimestampNow();
+        auto stale_ms = std::chrono::duration_cast<std::chrono::milliseconds>(settings_.stale_upload_after).count();
+        std::size_t removed = 0;
+        for (const auto& file : db_.getUnfinishedFiles()) {
+            if (now_ms - file.created_at < stale_ms) {
+                continue;
+            }
+            // Время последнего чанка - mtime part-файла
+            std::error_code ec;
+            auto part = partPath(file.id);
+            auto modified = std::filesystem::last_write_time(part, ec);
+            if (!ec && std::filesystem::file_time_type::clock::now() - modified < settings_.stale_upload_after) {
+                continue;
+            }
+
+            // Чанк, пишущийся прямо сейчас, дождется нас и увидит, что загрузки больше нет
+            auto upload_mutex = uploadMutex(file.id);
+            std::lock_guard<std::mutex> lock(*upload_mutex);
+            if (db_.removeUnfinishedFile(file.id)) {
+                std::filesystem::remove(part, ec);
+                ++removed;
+            }
+        }
+        if (removed > 0) {
+            LOG_INFO("stale uploads removed", "count", removed);
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("error removing stale uploads", "error", e.what());
+    }
+}
+
+bool FileStore::isValidId(std::string_view file_id) {
+    if (file_id.size() != kIdLength) {
+        return false;
+    }
+    for (char c : file_id) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string FileStore::generateId() {
+    static constexpr char kHex[] = "0123456789abcdef";
+    thread_local std::mt19937_64 generator = []() {
+        std::random_device device;
+        std::seed_seq seed{device(), device(), device(), device()};
+        return std::mt19937_64(seed);
+    }();
+
+    std::string id;
+    id.reserve(kIdLength);
+    for (int part = 0; part < 2; ++part) {
+        std::uint64_t bits = generator();
+        for (int i = 0; i < 16; ++i) {
+            id += kHex[bits & 0xF];
+            bits >>= 4;
+        }
+    }
+    return id;
+}
+
+std::filesystem::path FileStore::partPath(const std::string& file_id) const {
+    return blob_dir_ / (file_id + ".part");
+}
+
+std::filesystem::path FileStore::blobPath(const std::string& file_id) const {
+    return blob_dir_ / file_id;
+}
@@ -3,10 +3,15 @@
 
 #include <sqlite3.h>
 #include <string>
-#include <iostream>
+#include <cstdint>
+#include "logger.h"
+#include "prepared_statement.h"
+#include "server_config.h"
 #include <stdexcept>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
 
 struct User {
     int id;
@@ -16,35 +21,78 @@ struct User {
     std::string created_at;
 };
 
+// Wall-clock time for a new message in Unix epoch milliseconds; never smaller
+// than a value returned before, so ordering by (sent_at, id) follows send order
+std::int64_t messageTimestampNow();
+
+// Row handed to commitBatch()
+struct NewMessage {
+    int sender_id;
+    int receiver_id;
+    std::string content;
+    std::int64_t sent_at; // Unix epoch milliseconds
+    std::int64_t seq;     // Position in the sender -> receiver stream, starting at 1
+    bool is_delivered = true;
+    bool is_file = false;
+    std::string file_path;
+};
+
 struct Message {
-    int id;
+    std::int64_t id;
     int sender_id;
     int receiver_id;
     std::string content;
-    std::string sent_at;
+    std::int64_t sent_at; // Unix epoch milliseconds
+    std::int64_t seq;
     bool is_file;
     std::string file_path;
     bool is_delivered;
 };
 
+// Receiver confirmed every message of the sender -> receiver stream up to seq
+struct DeliveryAck {
+    int receiver_id;
+    int sender_id;
+    std::int64_t seq;
+};
+
+// File sent through the chunked upload protocol; its bytes live in the blob directory
+struct FileRecord {
+    std::string id; // Random hex token, also the blob file name
+    int sender_id;
+    int receiver_id;
+    std::string name; // As given by the sender, never used as a path
+    std::uint64_t size;
+    std::int64_t created_at;   // Unix epoch milliseconds
+    bool complete;
+};
+
+// Unfinished uploads of one sender
+struct UploadUsage {
+    std::size_t count;
+    std::uint64_t bytes; // Declared sizes
+};
+
+// Highest acknowledged seq of one incoming stream
+struct AckWatermark {
+    std::string sender;
+    std::int64_t acked_seq;
+};
+
+// SQLite in WAL mode: one writer connection (behind mutex_) plus a pool of
+// read-only connections, so user lookups and sequence reads never wait for
+// inserts and run in parallel on the io threads.
 class Database {
 public:
-    Database(const std::string& db_path) {
-        if (sqlite3_open(db_path.c_str(), &db_)) {
-            std::string error_msg = "Can't open database: ";
-            error_msg += sqlite3_errmsg(db_);
-            throw std::runtime_error(error_msg);
-        } else {
-            std::cout << "Opened database successfully" << std::endl;
-        }
-        initialize();
+    Database(const std::string& db_path, const DatabaseSettings& settings = {})
+        : db_(db_path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE) {
+        LOG_INFO("database opened", "path", db_path);
+        initialize(settings);
+        openReaders(db_path, settings);
     }
 
-    ~Database() {
-        if (db_) {
-            sqlite3_close(db_);
-        }
-    }
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
 
     // User operations
     bool addUser(const std::string& username, const std::string& email, const std::string& password_hash);
@@ -52,14 +100,102 @@ public:
     std::unique_ptr<User> getUserById(int user_id);
     
     // Message operations
-    bool storeMessage(int sender_id, int receiver_id, const std::string& content, bool is_delivered = true, bool is_file = false, const std::string& file_path = "");
-    std::vector<Message> getMessages(int user_id, int other_user_id, int limit = 50);
-    std::vector<Message> getOfflineMessages(int user_id);
-    bool deleteOfflineMessages(int user_id);
+    // Inserts the rows and applies the acks (raises the watermark, marks the rows
+    // delivered) in one transaction; nothing is stored if any statement fails.
+    // Rows inserted as delivered move their stream's watermark as well
+    bool commitBatch(const std::vector<NewMessage>& messages, const std::vector<DeliveryAck>& acks = {});
+    // Offline delivery page: up to `limit` undelivered messages to user_id with id > after_id,
+    // in id order. Rows that arrive meanwhile have larger ids and stay for the next page
+    bool readOfflineMessages(int user_id, std::int64_t after_id, std::size_t limit, std::vector<Message>& page);
+    // Marks the page (after_id, last_id] delivered once it has been written to a client
+    // without acks, and moves the watermarks of the page's senders past it; clients
+    // with acks mark rows through commitBatch()
+    bool markOfflineDelivered(int user_id, std::int64_t after_id, std::int64_t last_id,
+                              const std::vector<int>& sender_ids);
+
+    // Delivery tracking
+    std::int64_t lastSequence(int sender_id, int receiver_id);
+    std::vector<AckWatermark> getAckWatermarks(int receiver_id);
+
+    // File transfer bookkeeping
+    bool addFile(const FileRecord& file);
+    std::unique_ptr<FileRecord> getFile(const std::string& file_id);
+    bool completeFile(const std::string& file_id, std::int64_t completed_at);
+    UploadUsage getUploadUsage(int sender_id);
+    std::vector<FileRecord> getUnfinishedFiles();
+    bool removeUnfinishedFile(const std::string& file_id);
+
+    static bool isValidSynchronousMode(const std::string& mode);
 
 private:
-    void initialize();
-    sqlite3* db_ = nullptr;
+    // Statements run on the writer connection, prepared once in initialize()
+    struct Statements {
+        PreparedStatement add_user;
+        PreparedStatement store_message;
+        PreparedStatement select_offline_page;
+        PreparedStatement mark_offline_delivered;
+        PreparedStatement raise_ack_watermark;
+        PreparedStatement mark_acked_delivered;
+        PreparedStatement sync_ack_watermark;
+        PreparedStatement add_file;
+        PreparedStatement complete_file;
+        PreparedStatement remove_unfinished_file;
+        PreparedStatement begin;
+        PreparedStatement commit;
+        PreparedStatement rollback;
+    };
+
+    // Read-only connection of the pool with its own prepared statements
+    // db is declared first: statements are finalized before the connection closes,
+    // including when the constructor throws halfway through
+    struct ReaderConnection {
+        SqliteConnection db;
+        PreparedStatement get_user;
+        PreparedStatement get_user_by_id;
+        PreparedStatement last_sequence;
+        PreparedStatement get_ack_watermarks;
+        PreparedStatement get_file;
+        PreparedStatement get_upload_usage;
+        PreparedStatement get_unfinished_files;
+
+        ReaderConnection(const std::string& db_path, const DatabaseSettings& settings);
+        ReaderConnection(const ReaderConnection&) = delete;
+        ReaderConnection& operator=(const ReaderConnection&) = delete;
+    };
+
+    // Borrows an idle reader for one query, waiting if all are busy
+    class ReaderLease {
+    public:
+        explicit ReaderLease(Database& database);
+        ~ReaderLease();
+        ReaderLease(const ReaderLease&) = delete;
+        ReaderLease& operator=(const ReaderLease&) = delete;
+
+        ReaderConnection* operator->() const { return reader_; }
+
+    private:
+        Database& database_;
+        ReaderConnection* reader_;
+    };
+
+    void initialize(const DatabaseSettings& settings);
+    void prepareStatements();
+    void openReaders(const std::string& db_path, const DatabaseSettings& settings);
+    // Watermark of the stream up to its first undelivered row; caller holds mutex_
+    bool syncAckWatermark(int receiver_id, int sender_id);
+    // Declared first: readers and statements are released before the writer connection
+    // closes, also when initialize() or openReaders() throws out of the constructor
+    SqliteConnection db_;
+    std::unique_ptr<Statements> statements_;
+
+    // One writer connection shared by all threads; the lock keeps each
+    // statement and its sqlite3_errmsg() together
+    std::mutex mutex_;
+
+    std::vector<std::unique_ptr<ReaderConnection>> readers_;
+    std::vector<ReaderConnection*> idle_readers_;
+    std::mutex readers_mutex_;
+    std::condition_variable reader_released_;
 };
 
 #endif // DATABASE_HPP
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef FAST_REQUEST_PARSER_H
+#define FAST_REQUEST_PARSER_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+
+// Optional client-chosen "id" of a request, echoed in its *_response so
+// pipelined requests can be matched to their completions
+using RequestId = std::optional<std::uint64_t>;
+
+// Requests of the hot message types. String fields are views that stay
+// valid while the frame (and the parser that produced them) is alive.
+struct ChatMessageRequest {
+    std::string_view to;
+    std::string_view content;
+    RequestId id;
+};
+
+struct TypingRequest {
+    std::string_view to;
+    bool is_typing;
+    RequestId id;
+};
+
+struct LoginRequest {
+    std::string_view username;
+    std::string_view password;
+    RequestId id;
+    bool acks = false; // Client confirms deliveries with "ack"; unacked messages are redelivered
+};
+
+struct RegisterRequest {
+    std::string_view username;
+    std::string_view email;
+    std::string_view password;
+    RequestId id;
+};
+
+// Receiver confirms every message from `from` up to and including `seq`
+struct AckRequest {
+    std::string_view from;
+    std::uint64_t seq;
+    RequestId id;
+};
+
+using FastRequest = std::variant<std::monostate, ChatMessageRequest, TypingRequest, LoginRequest, RegisterRequest,
+                                 AckRequest>;
+
+// On-demand parser for the flat objects clients send most often.
+// The frame is scanned once without building a DOM; strings without escapes are
+// returned as views into the frame, escaped ones are decoded into an internal buffer.
+// Anything unusual (unknown or duplicate keys, other value types, \u escapes, non-integer ids,
+// invalid UTF-8, missing fields) yields std::monostate, and the caller falls
+// back to the nlohmann DOM, which keeps all error reporting in one place.
+class FastRequestParser {
+public:
+    FastRequest parse(std::string_view frame);
+
+private:
+    enum Field {
+        kType,
+        kTo,
+        kContent,
+        kIsTyping,
+        kUsername,
+        kEmail,
+        kPassword,
+        kId,
+        kFrom,
+        kSeq,
+        kAcks,
+        kFieldCount
+    };
+
+    bool parseObject();
+    bool parseString(std::string_view& out);
+    bool parseBool(bool& out);
+    bool parseUnsigned(std::uint64_t& out);
+    void skipWhitespace();
+    bool has(Field field) const { return (present_ & (1u << field)) != 0; }
+    // "id" is optional for every request type
+    bool hasExactly(unsigned fields) const { return (present_ & ~(1u << kId)) == fields; }
+    RequestId id() const { return has(kId) ? RequestId(id_) : std::nullopt; }
+
+    std::string_view input_;
+    std::size_t pos_ = 0;
+    std::string scratch_; // Decoded escaped strings; reserved once so views stay valid
+
+    unsigned present_ = 0;
+    std::string_view strings_[kFieldCount];
+    bool is_typing_ = false;
+    bool acks_ = false;
+    std::uint64_t id_ = 0;
+    std::uint64_t seq_ = 0;
+};
+
+#endif // FAST_REQUEST_PARSER_H
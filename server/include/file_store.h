@@ -0,0 +1,107 @@
+#ifndef FILE_STORE_H
+#define FILE_STORE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "database.h"
+#include "payload_encoding.h"
+#include "server_config.h"
+#include "timing_wheel.h"
+
+// Read-only handle to a finished blob, shared by the queued chunks of a download
+class BlobFile {
+public:
+    // nullptr if the file cannot be opened
+    static std::shared_ptr<const BlobFile> open(const std::filesystem::path& path);
+    ~BlobFile();
+
+    BlobFile(const BlobFile&) = delete;
+    BlobFile& operator=(const BlobFile&) = delete;
+
+    int nativeHandle() const { return fd_; } // For sendfile()
+    // Reads exactly `length` bytes at `offset` without moving a shared file position
+    bool read(std::uint64_t offset, std::size_t length, std::string& out) const;
+
+private:
+    explicit BlobFile(int fd) : fd_(fd) {}
+    int fd_;
+};
+
+// Files of the chunked transfer protocol. An upload is a row in `files` plus
+// <blob_dir>/<id>.part; the bytes already on disk are the resume offset, so an
+// upload continues from any connection (or after a restart). The last chunk
+// renames the part file to <blob_dir>/<id> and marks the row complete.
+// Each sender has a cap on unfinished uploads and their declared bytes; uploads
+// left untouched for stale_upload_after are deleted by a periodic sweep.
+class FileStore {
+public:
+    enum class CreateResult {
+        Created,
+        TooManyUploads, // max_open_uploads unfinished uploads already
+        QuotaExceeded,  // Would exceed max_pending_bytes
+        Failed
+    };
+
+    enum class ChunkResult {
+        Accepted,
+        Completed,   // This chunk finished the file
+        WrongOffset, // Not at the current end of the upload; `received` says where it is
+        TooLarge,    // Past the declared size
+        UnknownFile, // No such upload of this sender
+        Failed
+    };
+
+    // max_frame_size bounds the chunks a client can send in one frame
+    FileStore(Database& db, TimingWheel& timing_wheel, const FileTransferSettings& settings,
+              std::size_t max_frame_size);
+    ~FileStore();
+
+    FileStore(const FileStore&) = delete;
+    FileStore& operator=(const FileStore&) = delete;
+
+    const FileTransferSettings& settings() const { return settings_; }
+    // Largest chunk a client may upload in one file_chunk frame
+    std::size_t uploadChunkSize(PayloadEncoding encoding) const;
+
+    // Registers a new upload if the sender is within its limits
+    CreateResult createUpload(int sender_id, int receiver_id, std::string name, std::uint64_t size, FileRecord& file);
+    std::unique_ptr<FileRecord> find(const std::string& file_id);
+    // Bytes of an unfinished upload already on disk
+    std::uint64_t receivedBytes(const FileRecord& file);
+    ChunkResult appendChunk(FileRecord& file, std::uint64_t offset, std::string_view data, std::uint64_t& received);
+    std::shared_ptr<const BlobFile> openBlob(const FileRecord& file);
+
+    // Ids are generated here; anything else is rejected before it reaches a path
+    static bool isValidId(std::string_view file_id);
+
+private:
+    static std::string generateId();
+    std::filesystem::path partPath(const std::string& file_id) const;
+    std::filesystem::path blobPath(const std::string& file_id) const;
+    // Lock of one upload: the offset check and write of a chunk are one step, even
+    // if the same upload is resumed from a second connection. Other uploads are not blocked
+    std::shared_ptr<std::mutex> uploadMutex(const std::string& file_id);
+    void scheduleCleanup();
+    void removeStaleUploads();
+
+    Database& db_;
+    TimingWheel& timing_wheel_;
+    const FileTransferSettings settings_;
+    const std::size_t max_frame_size_;
+    std::filesystem::path blob_dir_;
+
+    std::mutex upload_locks_mutex_;
+    std::unordered_map<std::string, std::weak_ptr<std::mutex>> upload_locks_;
+    std::size_t prune_locks_at_ = kMinLocksToPrune;
+    static constexpr std::size_t kMinLocksToPrune = 64;
+
+    std::mutex create_mutex_; // Limit check and insert of a new upload are one step
+    TimingWheel::Timer cleanup_timer_;
+};
+
+#endif // FILE_STORE_H
@@ -2,10 +2,13 @@
 #define JSON_PARSER_H
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <nlohmann/json.hpp>
 #include "user_manager.h"
 #include "router.h"
+#include "fast_request_parser.h"
+#include "commands.h"
 
 class Session; // Forward declaration
 
@@ -15,26 +18,52 @@ public:
     ~JsonParser() = default;
 
     // Message parsing and handling
-    void parseMessage(const std::string& raw_message, std::shared_ptr<Session> session);
+    void parseMessage(std::string_view raw_message, std::shared_ptr<Session> session);
     
     // Session management
-    void removeSessionFromManager(int user_id);
+    void removeSessionFromManager(int user_id, const Session* session);
     
 private:
     void handleRequest(const nlohmann::json& message, std::shared_ptr<Session> session);
     
     // Command handlers
+    void handleHello(const nlohmann::json& message, std::shared_ptr<Session> session);
     void handleRegister(const nlohmann::json& message, std::shared_ptr<Session> session);
     void handleLogin(const nlohmann::json& message, std::shared_ptr<Session> session);
     void handleMessage(const nlohmann::json& message, std::shared_ptr<Session> session);
     void handleTyping(const nlohmann::json& message, std::shared_ptr<Session> session);
+    void handleAck(const nlohmann::json& message, std::shared_ptr<Session> session);
+    void handleSubscribe(const nlohmann::json& message, std::shared_ptr<Session> session);
+    void handleUnsubscribe(const nlohmann::json& message, std::shared_ptr<Session> session);
+    void handleFileUpload(const nlohmann::json& message, std::shared_ptr<Session> session);
+    void handleFileChunk(const nlohmann::json& message, std::shared_ptr<Session> session);
+    void handleFileDownload(const nlohmann::json& message, std::shared_ptr<Session> session);
+    void handlePing(const nlohmann::json& message, std::shared_ptr<Session> session);
+    void handlePong(const nlohmann::json& message, std::shared_ptr<Session> session);
+
+    // Shared by the DOM handlers above and the FastRequestParser path
+    void handleRegister(const RegisterRequest& request, std::shared_ptr<Session> session);
+    void handleLogin(const LoginRequest& request, std::shared_ptr<Session> session);
+    void handleMessage(const ChatMessageRequest& request, std::shared_ptr<Session> session);
+    void handleTyping(const TypingRequest& request, std::shared_ptr<Session> session);
+    void handleAck(const AckRequest& request, std::shared_ptr<Session> session);
+    // Marks the session online and starts the offline drain once login_response is queued
+    void finishLogin(int user_id, const std::string& username, const std::shared_ptr<Session>& session);
     
     // Helper methods
     bool isSessionAuthenticated(std::shared_ptr<Session> session);
-    void sendResponse(std::shared_ptr<Session> session, const std::string& type, bool success, const std::string& message = "");
+    // "users" of a (un)subscribe request; false if missing or not an array of strings
+    static bool presenceUsers(const nlohmann::json& message, std::vector<std::string>& users);
+    // "data" of a file_chunk: base64 text in JSON, a bin value in the binary encodings
+    static bool fileChunkData(const nlohmann::json& message, std::string& data);
+    // Reply to `request`; `id` echoes the client's request id when it sent one
+    void sendResponse(std::shared_ptr<Session> session, Command request, RequestId id, bool success, const std::string& message = "");
     
     UserManager& user_manager_;
     Router& router_;
+
+    using RequestHandler = void (JsonParser::*)(const nlohmann::json&, std::shared_ptr<Session>);
+    CommandTable<RequestHandler> handlers_; // Filled once in the constructor
 };
 
 #endif // JSON_PARSER_HPP
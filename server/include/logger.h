@@ -0,0 +1,184 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel : int {
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3
+};
+
+// Levels below this are compiled out entirely (set by MESSENGER_LOG_LEVEL in CMake)
+#ifndef MESSENGER_LOG_MIN_LEVEL
+#define MESSENGER_LOG_MIN_LEVEL 1
+#endif
+constexpr LogLevel kCompiledLogLevel = static_cast<LogLevel>(MESSENGER_LOG_MIN_LEVEL);
+
+// Fixed-capacity text builder writing straight into a ring slot; output is truncated, never reallocated
+class LogLine {
+public:
+    LogLine(char* data, std::size_t capacity) : data_(data), capacity_(capacity), size_(0) {}
+
+    void append(std::string_view text) {
+        std::size_t n = std::min(text.size(), capacity_ - size_);
+        std::memcpy(data_ + size_, text.data(), n);
+        size_ += n;
+    }
+
+    void append(char c) {
+        if (size_ < capacity_) {
+            data_[size_++] = c;
+        }
+    }
+
+    template <typename T>
+    void appendValue(const T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            append(value ? std::string_view("true") : std::string_view("false"));
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            auto result = std::to_chars(data_ + size_, data_ + capacity_, value);
+            if (result.ec == std::errc()) {
+                size_ = result.ptr - data_;
+            }
+        } else {
+            appendQuoted(std::string_view(value));
+        }
+    }
+
+    std::size_t size() const { return size_; }
+
+private:
+    // Строки с пробелами берем в кавычки, чтобы key=value оставалось разбираемым
+    void appendQuoted(std::string_view text) {
+        bool quote = text.empty() || text.find_first_of(" \t\n\"=") != std::string_view::npos;
+        if (!quote) {
+            append(text);
+            return;
+        }
+        append('"');
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                append('\\');
+                append(c);
+            } else if (c == '\n') {
+                append("\\n");
+            } else {
+                append(c);
+            }
+        }
+        append('"');
+    }
+
+    char* data_;
+    std::size_t capacity_;
+    std::size_t size_;
+};
+
+// Asynchronous server log.
+// Io threads format a record into a slot of a bounded lock-free ring (multi-producer,
+// single consumer) and return; a background thread writes the records out in batches.
+// When the ring is full records are dropped and counted instead of blocking the caller.
+class Logger {
+public:
+    static constexpr std::size_t kRingSize = 4096; // Power of two
+    static constexpr std::size_t kMaxLineLength = 480;
+
+    static Logger& instance();
+
+    ~Logger();
+
+    void start();
+    // Writes out everything still queued and joins the drain thread
+    void stop();
+
+    // Runtime filter on top of the compiled one; Info by default
+    void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    bool enabled(LogLevel level) const { return level >= level_.load(std::memory_order_relaxed); }
+    std::uint64_t droppedRecords() const { return dropped_.load(std::memory_order_relaxed); }
+
+    static bool parseLevel(std::string_view name, LogLevel& level);
+
+    // Fields are key/value pairs: log(level, "message delivered", "from", from, "to", to)
+    template <typename... Fields>
+    void log(LogLevel level, std::string_view message, const Fields&... fields) {
+        static_assert(sizeof...(Fields) % 2 == 0, "log fields must be key/value pairs");
+
+        std::size_t position;
+        Slot* slot = acquire(position);
+        if (slot == nullptr) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        LogLine line(slot->text, kMaxLineLength);
+        line.append(message);
+        appendFields(line, fields...);
+        slot->length = line.size();
+        slot->level = level;
+        slot->time = std::chrono::system_clock::now();
+        slot->sequence.store(position + 1, std::memory_order_release);
+    }
+
+private:
+    struct Slot {
+        std::atomic<std::size_t> sequence;
+        LogLevel level;
+        std::chrono::system_clock::time_point time;
+        std::size_t length;
+        char text[kMaxLineLength];
+    };
+
+    Logger();
+
+    static void appendFields(LogLine&) {}
+
+    template <typename Value, typename... Rest>
+    static void appendFields(LogLine& line, std::string_view key, const Value& value, const Rest&... rest) {
+        line.append(' ');
+        line.append(key);
+        line.append('=');
+        line.appendValue(value);
+        appendFields(line, rest...);
+    }
+
+    Slot* acquire(std::size_t& position);
+    bool drainBatch();
+    void run();
+
+    std::unique_ptr<Slot[]> ring_;
+    alignas(64) std::atomic<std::size_t> enqueue_pos_;
+    alignas(64) std::size_t dequeue_pos_; // Touched by the drain thread only
+    std::atomic<LogLevel> level_;
+    std::atomic<std::uint64_t> dropped_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
+
+// Arguments of a compiled-out level are not evaluated
+#define MESSENGER_LOG(level, ...)                                   \
+    do {                                                            \
+        if constexpr ((level) >= kCompiledLogLevel) {               \
+            if (Logger::instance().enabled(level)) {                \
+                Logger::instance().log((level), __VA_ARGS__);       \
+            }                                                       \
+        }                                                           \
+    } while (false)
+
+#define LOG_DEBUG(...) MESSENGER_LOG(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) MESSENGER_LOG(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) MESSENGER_LOG(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) MESSENGER_LOG(LogLevel::Error, __VA_ARGS__)
+
+#endif // LOGGER_H
@@ -0,0 +1,79 @@
+#ifndef MESSAGE_WRITER_H
+#define MESSAGE_WRITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "database.h"
+#include "server_config.h"
+
+// Write-behind persistence for chat messages and delivery acks.
+// Io threads only append to an in-memory queue; a dedicated thread inserts the
+// queued rows in one transaction (group commit) once max_batch rows have piled
+// up or flush_interval has passed, so delivery never waits on an fsync.
+// Acks are kept as one watermark per stream, so a burst of acks costs a
+// single UPDATE per (receiver, sender) in the next batch.
+class MessageWriter {
+public:
+    MessageWriter(Database& db, const PersistenceSettings& settings);
+    ~MessageWriter();
+
+    void start();
+    // Commits everything still queued and joins the writer thread
+    void stop();
+
+    void enqueue(NewMessage message);
+    void enqueueAck(const DeliveryAck& ack);
+
+    // Called with true once every row and ack enqueued before the call is committed,
+    // or with false if a batch holding some of them was given up on. Never blocks:
+    // the callback runs on the writer thread (or inline when nothing is queued),
+    // so it must only hand work off, e.g. post it to a session
+    using CommitCallback = std::function<void(bool committed)>;
+    void whenCommitted(CommitCallback callback);
+
+private:
+    struct CommitWaiter {
+        std::uint64_t target; // enqueued_count_ at registration
+        bool committed;
+        CommitCallback callback;
+    };
+
+    void run();
+    // Retries a failed batch with backoff; after kMaxRetries attempts (kStopRetries
+    // during stop()) the batch is dropped with an error, so a persistent database
+    // failure fails requests instead of stalling the writer for good
+    bool commitWithRetry(const std::vector<NewMessage>& batch, const std::vector<DeliveryAck>& acks);
+    // Records a batch ending at `last`; returns the waiters it completes
+    std::vector<CommitWaiter> finishBatchLocked(std::uint64_t last, bool committed);
+    bool hasPendingLocked() const { return !pending_.empty() || !pending_acks_.empty(); }
+    std::size_t pendingCountLocked() const { return pending_.size() + pending_acks_.size(); }
+    void mergeAckLocked(const DeliveryAck& ack); // Keeps the highest seq per stream
+    std::vector<DeliveryAck> takeAcksLocked();
+
+    static constexpr std::chrono::milliseconds kRetryBackoffMin{50};
+    static constexpr std::chrono::milliseconds kRetryBackoffMax{2000};
+    static constexpr std::size_t kMaxRetries = 8; // About 7 s of backoff
+    static constexpr std::size_t kStopRetries = 5;
+
+    Database& db_;
+    PersistenceSettings settings_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_; // Writer: new rows, commit waiter or stop
+    std::vector<NewMessage> pending_;
+    std::unordered_map<std::uint64_t, DeliveryAck> pending_acks_; // Keyed by (receiver_id, sender_id)
+    std::uint64_t enqueued_count_;
+    std::uint64_t committed_count_;
+    std::vector<CommitWaiter> commit_waiters_; // Ordered by target
+    bool running_;
+    bool stopping_;
+    std::thread thread_;
+};
+
+#endif // MESSAGE_WRITER_H
@@ -0,0 +1,46 @@
+#ifndef OUTBOUND_FRAME_H
+#define OUTBOUND_FRAME_H
+
+#include <nlohmann/json.hpp>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "payload_encoding.h"
+
+// Immutable server message shared by reference count between every session it
+// is delivered to. Each encoding is produced on first use and then reused, so a
+// frame is serialized at most once per encoding no matter how many recipients
+// it has; sessions only add their own framing around the payload.
+class OutboundFrame {
+public:
+    struct JsonText {
+        std::string text; // Complete serialized JSON object
+    };
+
+    explicit OutboundFrame(nlohmann::json message);
+    // Frame built as JSON text without a DOM (ephemeral hot paths such as typing).
+    // Binary encodings parse the text once, on first use
+    explicit OutboundFrame(JsonText json);
+
+    static std::shared_ptr<const OutboundFrame> fromJson(nlohmann::json message);
+    static std::shared_ptr<const OutboundFrame> fromJsonText(std::string text);
+
+    // Encoded body without any delimiter
+    std::string_view payload(PayloadEncoding encoding = PayloadEncoding::Json) const;
+    // JSON payload followed by '\n', ready to be written as-is in newline framing
+    std::string_view newlineTerminated() const;
+
+private:
+    const std::string& encoded(PayloadEncoding encoding) const;
+
+    const nlohmann::json message_; // Null for frames created from JSON text
+    const bool from_text_;
+    mutable std::array<std::once_flag, kPayloadEncodingCount> once_;
+    mutable std::array<std::string, kPayloadEncodingCount> encoded_; // JSON entry keeps the trailing '\n'
+};
+
+using SharedFrame = std::shared_ptr<const OutboundFrame>;
+
+#endif // OUTBOUND_FRAME_H
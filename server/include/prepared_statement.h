@@ -0,0 +1,100 @@
+#ifndef PREPARED_STATEMENT_H
+#define PREPARED_STATEMENT_H
+
+#include <sqlite3.h>
+#include <stdexcept>
+#include <string>
+
+// Owns an open connection; closed on destruction. Declare it before the
+// PreparedStatement members of the same object so they are finalized first.
+class SqliteConnection {
+public:
+    SqliteConnection(const std::string& path, int flags) {
+        if (sqlite3_open_v2(path.c_str(), &db_, flags, nullptr) != SQLITE_OK) {
+            std::string error = "Can't open connection: ";
+            error += sqlite3_errmsg(db_);
+            sqlite3_close(db_);
+            throw std::runtime_error(error);
+        }
+    }
+
+    ~SqliteConnection() {
+        sqlite3_close(db_);
+    }
+
+    SqliteConnection(const SqliteConnection&) = delete;
+    SqliteConnection& operator=(const SqliteConnection&) = delete;
+
+    sqlite3* get() const { return db_; }
+    operator sqlite3*() const { return db_; }
+
+private:
+    sqlite3* db_ = nullptr;
+};
+
+// Owns a statement prepared once per connection; finalized on destruction.
+// Must be destroyed before its connection is closed.
+class PreparedStatement {
+public:
+    PreparedStatement() = default;
+
+    PreparedStatement(sqlite3* db, const char* sql) {
+        if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt_, nullptr) != SQLITE_OK) {
+            std::string error = "Failed to prepare statement: ";
+            error += sqlite3_errmsg(db);
+            error += " (";
+            error += sql;
+            error += ")";
+            throw std::runtime_error(error);
+        }
+    }
+
+    ~PreparedStatement() {
+        sqlite3_finalize(stmt_); // nullptr is a no-op
+    }
+
+    PreparedStatement(const PreparedStatement&) = delete;
+    PreparedStatement& operator=(const PreparedStatement&) = delete;
+
+    PreparedStatement(PreparedStatement&& other) noexcept : stmt_(other.stmt_) {
+        other.stmt_ = nullptr;
+    }
+
+    PreparedStatement& operator=(PreparedStatement&& other) noexcept {
+        if (this != &other) {
+            sqlite3_finalize(stmt_);
+            stmt_ = other.stmt_;
+            other.stmt_ = nullptr;
+        }
+        return *this;
+    }
+
+    sqlite3_stmt* get() const { return stmt_; }
+
+private:
+    sqlite3_stmt* stmt_ = nullptr;
+};
+
+// One use of a cached statement: on scope exit the statement is reset and its
+// bindings cleared, so it is ready for the next caller even after an early return.
+// Hold the connection lock for the lifetime of the scope.
+class StatementScope {
+public:
+    explicit StatementScope(const PreparedStatement& statement) : stmt_(statement.get()) {}
+
+    ~StatementScope() {
+        sqlite3_reset(stmt_);
+        sqlite3_clear_bindings(stmt_);
+    }
+
+    StatementScope(const StatementScope&) = delete;
+    StatementScope& operator=(const StatementScope&) = delete;
+
+    sqlite3_stmt* get() const { return stmt_; }
+    operator sqlite3_stmt*() const { return stmt_; }
+
+private:
+    sqlite3_stmt* stmt_;
+};
+
+#endif // PREPARED_STATEMENT_H
@@ -0,0 +1,62 @@
+#ifndef PRESENCE_MANAGER_H
+#define PRESENCE_MANAGER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "server_config.h"
+#include "timing_wheel.h"
+
+class Session; // Forward declaration
+
+// Online/offline notifications for users a session subscribed to.
+// Subscribers are indexed by the user they watch, so a login or logout touches
+// only that user's subscribers. Changes are not sent one by one: each subscriber
+// collects the latest state per watched user and a timing wheel flush pushes a
+// single "presence" frame with the users that actually changed since the last one.
+class PresenceManager {
+public:
+    PresenceManager(TimingWheel& timing_wheel, const PresenceSettings& settings);
+    ~PresenceManager();
+
+    PresenceManager(const PresenceManager&) = delete;
+    PresenceManager& operator=(const PresenceManager&) = delete;
+
+    // `online` is the state the subscriber was just told (subscribe_response).
+    // Returns false, changing nothing, if it would exceed max_subscriptions
+    bool subscribe(const std::shared_ptr<Session>& subscriber,
+                   const std::vector<std::pair<std::string, bool>>& users);
+    void unsubscribe(const Session* subscriber, const std::vector<std::string>& usernames);
+    void removeSubscriber(const Session* subscriber);
+
+    // Called by UserManager under its session lock, so one user's changes arrive in order
+    void publish(const std::string& username, bool online);
+
+private:
+    struct Subscriber {
+        std::weak_ptr<Session> session;
+        std::unordered_map<std::string, bool> watched; // User -> state the subscriber last heard
+        std::unordered_map<std::string, bool> pending; // Latest state since the last flush
+        bool dirty = false;
+    };
+
+    void unwatchLocked(const Session* subscriber, const std::string& username);
+    void scheduleFlushLocked();
+    void flush();
+
+    TimingWheel& timing_wheel_;
+    const PresenceSettings settings_;
+
+    std::mutex mutex_;
+    std::unordered_map<const Session*, Subscriber> subscribers_;
+    std::unordered_map<std::string, std::unordered_set<const Session*>> watchers_; // Watched user -> subscribers
+    std::vector<const Session*> dirty_; // Subscribers with pending changes, in order of the first one
+    bool flush_scheduled_;
+    TimingWheel::Timer flush_timer_;
+};
+
+#endif // PRESENCE_MANAGER_H
@@ -1,32 +1,123 @@
 #ifndef ROUTER_H
 #define ROUTER_H
 
+#include <boost/asio/thread_pool.hpp>
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include "database.h"
+#include "file_store.h"
+#include "message_writer.h"
 #include "user_manager.h"
+#include "fast_request_parser.h"
+#include "server_config.h"
+#include "timing_wheel.h"
+#include "typing_coalescer.h"
 
 class Session; // Forward declaration
 
 class Router {
 public:
-    Router(Database& db, UserManager& user_manager);
-    ~Router() = default;
+    Router(Database& db, UserManager& user_manager, MessageWriter& message_writer, FileStore& file_store,
+           TimingWheel& timing_wheel, const TypingSettings& typing_settings);
+    ~Router();
 
     // Message routing
-    void routeMessage(const nlohmann::json& message, std::shared_ptr<Session> sender_session, int sender_user_id);
-    void sendTypingStatus(const std::string& from_username, const std::string& to_username, bool is_typing);
+    void routeMessage(const ChatMessageRequest& message, std::shared_ptr<Session> sender_session, int sender_user_id);
+    // Typing events are coalesced per pair; only state changes reach the receiver, rate-limited
+    void sendTypingStatus(const std::string& from_username, std::string_view to_username, bool is_typing);
     
-    // File operations (for future implementation)
-    void routeFileTransfer(const nlohmann::json& message, std::shared_ptr<Session> sender_session);
+    // File transfer: an upload is announced, then its chunks are appended in order and
+    // it can be resumed by id from any connection of the sender. The finished file
+    // reaches the receiver as a message with "is_file"
+    bool beginUpload(int sender_id, std::string_view to_username, std::string name, std::uint64_t size,
+                     FileRecord& file, std::string& error);
+    bool resumeUpload(int sender_id, const std::string& file_id, FileRecord& file, std::uint64_t& received,
+                      std::string& error);
+    FileStore::ChunkResult receiveFileChunk(std::shared_ptr<Session> sender_session, const std::string& file_id,
+                                            std::uint64_t offset, std::string_view data, std::uint64_t& received);
+    // Only the sender and the receiver may download; the chunks follow with sendFile()
+    std::shared_ptr<const BlobFile> openDownload(int user_id, const std::string& file_id, FileRecord& file,
+                                                 std::string& error);
+    void sendFile(std::shared_ptr<Session> session, FileRecord file, std::shared_ptr<const BlobFile> blob,
+                  std::uint64_t offset);
+    std::size_t uploadChunkSize(PayloadEncoding encoding) const { return file_store_.uploadChunkSize(encoding); }
 
+    // Runs `callback` on the session's strand once the messages and acks queued so far
+    // have reached the database (or were given up on); never blocks the calling thread
+    void afterQueuedWrites(const std::shared_ptr<Session>& session, std::function<void()> callback);
+    // Streams the user's undelivered messages, starting after the queued writes commit.
+    // Call after the session is added, so no offline row can be queued behind the drain
     void sendStoredMessages(int user_id, std::shared_ptr<Session> session);
+
+    // Delivery acks: the receiver confirmed every message from `from_username` up to `seq`
+    void acknowledge(int receiver_id, std::string_view from_username, std::uint64_t seq);
+    // Ack watermarks of the user's incoming streams as stored; call it from
+    // afterQueuedWrites() so acks still queued for writing are included
+    std::vector<AckWatermark> ackWatermarks(int receiver_id);
 private:
-    void deliverMessage(const nlohmann::json& message, int sender_id, const std::string& receiver_username);
+    struct FileDownload {
+        FileRecord file;
+        std::shared_ptr<const BlobFile> blob;
+    };
+
+    // Stores and delivers the message announcing a finished upload
+    void routeFileTransfer(const FileRecord& file, std::shared_ptr<Session> sender_session);
+    // Queues one chunk; the next one follows once the session's queue drains. Chunks for
+    // newline framing are read and base64-encoded on file_reads_, not on the io thread
+    void sendFileChunk(const std::shared_ptr<Session>& session, std::shared_ptr<const FileDownload> download,
+                       std::uint64_t offset);
+    void continueDownload(const std::shared_ptr<Session>& session, std::shared_ptr<const FileDownload> download,
+                          std::uint64_t next);
+    void forwardTypingStatus(const std::string& from_username, const std::string& to_username, bool is_typing);
+    // `file` is set for the message announcing a finished upload
+    void deliverMessage(const ChatMessageRequest& message, std::shared_ptr<Session> sender_session, int sender_id,
+                        const FileRecord* file = nullptr);
+    void sendStoredPage(int user_id, const std::shared_ptr<Session>& session, std::int64_t after_id, std::size_t sent);
+    // Assigns the next seq of the sender -> receiver stream and queues the row
+    std::int64_t storeInStream(NewMessage message);
+    std::int64_t storeInStreamLocked(NewMessage message);
+    std::int64_t& streamSequenceLocked(int sender_id, int receiver_id);
+    void scheduleStreamEvictionLocked();
+    // Forgets the streams unused since the previous eviction once their queued rows are
+    // committed; streamSequenceLocked() reloads them from the database on next use
+    void evictIdleStreams();
+
+    static constexpr std::size_t kOfflinePageSize = 256; // Offline messages read (and marked delivered) at a time
+    static constexpr std::size_t kMinStreamsToEvict = 4096;
+    static constexpr std::chrono::milliseconds kStreamEvictionDelay{1000};
+    static constexpr std::size_t kFileReadThreads = 2;
     //void storeOfflineMessage(const nlohmann::json& message, int sender_id, int receiver_id);
     
     Database& db_;
     UserManager& user_manager_;
+    MessageWriter& message_writer_; // Messages are persisted write-behind
+    FileStore& file_store_;
+    TimingWheel& timing_wheel_;
+
+    struct StreamSequence {
+        std::int64_t last_seq;
+        std::uint64_t epoch; // stream_epoch_ at the last use
+    };
+
+    // Last seq of recently used sender -> receiver streams, loaded from the database on
+    // first use. Held while the row is queued, so ids follow seq order. Once the map
+    // reaches stream_eviction_at_ entries, idle streams are evicted
+    std::mutex streams_mutex_;
+    std::unordered_map<std::uint64_t, StreamSequence> stream_sequences_;
+    std::uint64_t stream_epoch_;
+    std::size_t stream_eviction_at_;
+    bool stream_eviction_scheduled_;
+    TimingWheel::Timer stream_eviction_timer_;
+
+    TypingCoalescer typing_;
+
+    // Blocking blob reads for base64 chunks. Declared last: joined before the rest is destroyed
+    boost::asio::thread_pool file_reads_;
 };
 
 #endif // ROUTER_HPP
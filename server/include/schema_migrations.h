@@ -0,0 +1,23 @@
+#ifndef SCHEMA_MIGRATIONS_H
+#define SCHEMA_MIGRATIONS_H
+
+#include <sqlite3.h>
+#include <vector>
+
+// One step of the database schema. Versions are consecutive, starting at 1;
+// a released migration is never edited - schema changes get a new entry.
+struct Migration {
+    int version;
+    const char* description;
+    const char* sql;                 // May hold several statements
+    void (*prepare)(sqlite3*) = nullptr; // Runs before sql, in the same transaction, for steps SQL alone can't express
+};
+
+const std::vector<Migration>& schemaMigrations();
+
+// Applies every migration newer than the version recorded in schema_version,
+// each in its own transaction; throws std::runtime_error on failure.
+// Returns the resulting schema version.
+int applyMigrations(sqlite3* db);
+
+#endif // SCHEMA_MIGRATIONS_H
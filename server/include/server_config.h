@@ -0,0 +1,106 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// What to do with a session whose outbound queue crossed the high watermark.
+// Droppable frames (typing) are shed first under every policy.
+enum class SlowConsumerPolicy {
+    DropTyping,   // Only shed droppable frames
+    PauseSender,  // Also stop reading from senders until the queue drains
+    Disconnect    // Close the slow session
+};
+
+// Per-session limits on bytes queued towards the client
+struct OutboundLimits {
+    std::size_t low_watermark = 256 * 1024;
+    std::size_t high_watermark = 1024 * 1024;
+    std::size_t hard_limit = 4 * 1024 * 1024; // Always disconnect beyond this
+    SlowConsumerPolicy policy = SlowConsumerPolicy::PauseSender;
+};
+
+// Connection liveness, driven by the server-wide timing wheel
+struct SessionTimeouts {
+    std::chrono::seconds login_timeout{30};       // Unauthenticated connections are closed after this
+    std::chrono::seconds heartbeat_interval{30};  // Idle this long -> server sends "ping"
+    std::chrono::seconds idle_timeout{90};        // Nothing received this long -> close
+    std::chrono::milliseconds wheel_tick{1000};
+};
+
+// SQLite tuning; the database always runs in WAL mode
+struct DatabaseSettings {
+    std::string synchronous = "NORMAL";     // PRAGMA synchronous: OFF, NORMAL, FULL or EXTRA
+    std::size_t cache_size_kib = 16 * 1024; // PRAGMA cache_size, per connection
+    std::size_t mmap_size = 256u << 20;     // PRAGMA mmap_size in bytes (0 disables mmap)
+    std::size_t reader_connections = 4;     // Read-only connections serving history/user lookups
+    std::chrono::milliseconds busy_timeout{5000};
+};
+
+// Group commit of the message write-behind queue
+struct PersistenceSettings {
+    std::size_t max_batch = 256;                  // Commit as soon as this many rows are queued
+    std::chrono::milliseconds flush_interval{10}; // ...or this long after the first queued row
+};
+
+// Typing indicators are coalesced per (sender, receiver) pair: repeats of the
+// state already forwarded are dropped and changes are throttled to one frame per interval
+struct TypingSettings {
+    std::chrono::milliseconds interval{1000}; // The last state held back is sent when the interval ends
+    std::chrono::seconds expiry{10};          // "Typing" not refreshed for this long is turned off for the receiver
+};
+
+// Presence subscriptions: online/offline changes of watched users are collected
+// per subscriber and pushed as one "presence" frame per flush
+struct PresenceSettings {
+    std::chrono::milliseconds flush_interval{1000}; // Rounded up to the timing wheel tick
+    std::size_t max_subscriptions = 1024;           // Users one session may watch
+};
+
+// Chunked file transfer: uploads are written to blob_dir, downloads are sent
+// chunk by chunk as the session's outbound queue drains
+struct FileTransferSettings {
+    std::string blob_dir = "blobs";
+    std::size_t chunk_size = 64 * 1024;       // File bytes per download chunk
+    std::uint64_t max_file_size = 1ull << 30; // Largest upload accepted
+    // Per sender: unfinished uploads and their declared bytes on disk at once
+    std::size_t max_open_uploads = 8;
+    std::uint64_t max_pending_bytes = 4ull << 30;
+    // Unfinished uploads untouched this long are deleted, checked every cleanup_interval
+    std::chrono::seconds stale_upload_after{24 * 60 * 60};
+    std::chrono::seconds cleanup_interval{10 * 60};
+};
+
+// Runtime settings of the server, filled from the command line in main()
+struct ServerConfig {
+    int port = 9999;
+    std::string db_path = "messenger.db";
+    DatabaseSettings database;
+
+    // Number of threads running the shared io_context (0 = one per core)
+    std::size_t io_threads = 0;
+
+    // Largest inbound frame payload; bigger frames get an error and the
+    // connection is closed, so a read buffer never grows much past this
+    std::size_t max_frame_size = 64 * 1024;
+
+    OutboundLimits outbound;
+    SessionTimeouts timeouts;
+    PersistenceSettings persistence;
+    TypingSettings typing;
+    PresenceSettings presence;
+    FileTransferSettings files;
+
+    std::size_t resolvedIoThreads() const {
+        if (io_threads != 0) {
+            return io_threads;
+        }
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores != 0 ? cores : 1;
+    }
+};
+
+#endif // SERVER_CONFIG_H
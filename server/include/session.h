@@ -4,34 +4,139 @@
 #include <boost/asio.hpp>
 #include <nlohmann/json.hpp>
 #include <memory>
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <string_view>
 #include <array>
+#include <deque>
+#include <functional>
+#include <vector>
+#include "file_store.h"
+#include "frame_buffer.h"
+#include "outbound_frame.h"
+#include "payload_encoding.h"
+#include "server_config.h"
+#include "timing_wheel.h"
 
 using boost::asio::ip::tcp;
 
 class JsonParser;
 
+// Droppable frames (typing indicators) are shed first when a client falls behind
+enum class SendPriority {
+    Normal,
+    Droppable
+};
+
+// Part of a finished blob, written from the file to the socket without passing
+// through user space (sendfile on Linux)
+struct FileSlice {
+    std::shared_ptr<const BlobFile> file;
+    std::uint64_t offset = 0;
+    std::size_t length = 0;
+};
+
+// Server-wide slow-consumer counters
+struct OutboundStats {
+    std::atomic<std::uint64_t> frames_dropped{0};
+    std::atomic<std::uint64_t> bytes_dropped{0};
+    std::atomic<std::uint64_t> sender_pauses{0};
+    std::atomic<std::uint64_t> slow_consumer_disconnects{0};
+};
+
 class Session : public std::enable_shared_from_this<Session> {
 public:
-    Session(tcp::socket socket, std::shared_ptr<JsonParser> json_parser);
+    Session(tcp::socket socket, std::shared_ptr<JsonParser> json_parser,
+            TimingWheel& timing_wheel, const ServerConfig& config);
     ~Session();
 
     void start();
-    void send(const nlohmann::json& message);
+    void send(nlohmann::json message, SendPriority priority = SendPriority::Normal);
+    // Pre-serialized frame, shared with other recipients without copying
+    void send(SharedFrame frame, SendPriority priority = SendPriority::Normal);
+
+    // File download chunk: `header`, followed in length-prefixed framing by a raw frame
+    // holding the slice. Chunks are written only while no other frame is queued, so a
+    // download delays chat traffic by at most one chunk; pace them with whenDrained()
+    void sendFileChunk(SharedFrame header, FileSlice slice = {});
+
+    // Backpressure: readable from any thread
+    std::size_t queuedBytes() const { return queued_bytes_.load(std::memory_order_relaxed); }
+    bool isCongested() const { return queuedBytes() > limits_.high_watermark; }
+    SlowConsumerPolicy slowConsumerPolicy() const { return limits_.policy; }
+
+    // Stops reading from `sender` until this session's queue drains below the low watermark
+    void pauseSenderUntilDrained(const std::shared_ptr<Session>& sender);
+    // Runs `callback` on the session's strand once the queue is at or below the low
+    // watermark (posted right away if it already is); dropped if the session closes first
+    void whenDrained(std::function<void()> callback);
+    // Runs `callback` on the session's strand once every frame queued before this call
+    // has been written to the socket; dropped if the session closes first
+    void whenWritten(std::function<void()> callback);
+    // Runs `callback` on the session's strand; safe from any thread, dropped if the session closes first
+    void post(std::function<void()> callback);
+
+    static const OutboundStats& outboundStats() { return stats_; }
     
     // Authentication state
     void setAuthenticated(int user_id, const std::string& username);
     bool isAuthenticated() const { return authenticated_; }
     int getUserId() const { return user_id_; }
     const std::string& getUsername() const { return username_; }
+
+    // Client confirms deliveries with "ack" (chosen at login); readable from any thread
+    void setDeliveryAcks(bool enabled) { delivery_acks_.store(enabled, std::memory_order_relaxed); }
+    bool deliveryAcks() const { return delivery_acks_.load(std::memory_order_relaxed); }
+
+    // Framing and body encoding negotiated by "hello"; must be called from the session's strand
+    void setFramingMode(FramingMode mode);
+    FramingMode getFramingMode() const { return write_framing_; }
+    void setPayloadEncoding(PayloadEncoding encoding) { payload_encoding_ = encoding; }
+    PayloadEncoding getPayloadEncoding() const { return payload_encoding_; }
     
     // Session management
     void close();
 
 private:
-    void do_read();
-    void do_write();
-    void handle_message(const std::string& message);
+    struct OutboundEntry {
+        SharedFrame frame;
+        std::string_view body; // Encoded payload inside `frame`, chosen when the entry was queued
+        std::array<char, FrameBuffer::kLengthPrefixSize> prefix; // Used in length-prefixed framing only
+        bool prefixed;
+        SendPriority priority;
+        std::size_t size; // Bytes on the wire, including framing
+        std::uint64_t ordinal; // Position in write_queue_ order, for whenWritten()
+    };
+
+    // Download chunk in the bulk lane; slice_prefix frames the raw slice bytes
+    struct FileChunkEntry {
+        OutboundEntry header;
+        FileSlice slice;
+        std::array<char, FrameBuffer::kLengthPrefixSize> slice_prefix;
+        std::size_t size; // Header plus slice on the wire
+    };
+
+    // One coroutine frame per direction for the lifetime of the connection;
+    // `self` keeps the session alive while the coroutine runs
+    boost::asio::awaitable<void> reader(std::shared_ptr<Session> self);
+    boost::asio::awaitable<void> writer(std::shared_ptr<Session> self);
+    boost::asio::awaitable<void> writeFileChunk(FileChunkEntry& chunk);
+    boost::asio::awaitable<void> writeFileSlice(const FileSlice& slice);
+    void handle_message(std::string_view message);
+    OutboundEntry makeEntry(SharedFrame frame, SendPriority priority) const;
+    void enqueue(SharedFrame frame, SendPriority priority);
+    void enqueueFileChunk(SharedFrame header, FileSlice slice);
+    void onBytesWritten(std::size_t length);
+    void rejectOversizedFrame();
+    void dropQueuedDroppable();
+    void pauseReading();
+    void resumeReading();
+    void resumePausedSenders();
+    void runDrainCallbacks();
+    void runWrittenCallbacks();
+    void armTimer(std::chrono::steady_clock::duration delay);
+    void onTimer();
     
     tcp::socket socket_;
     std::shared_ptr<JsonParser> json_parser_;
@@ -40,14 +145,46 @@ private:
     bool authenticated_;
     int user_id_;
     std::string username_;
+    std::atomic<bool> delivery_acks_;
     
     // Buffer management
-    std::array<char, 8192> read_buffer_;
-    std::string write_buffer_;
-    std::string message_buffer_; // For accumulating partial messages
+    FrameBuffer read_buffer_; // Accumulates partial messages, hands out whole frames
+
+    // Outbound queue: frames are coalesced into one gathered write,
+    // and at most one async_write is in flight at a time
+    std::deque<OutboundEntry> write_queue_;
+    std::vector<boost::asio::const_buffer> write_buffers_;
+    std::size_t frames_in_flight_;
+    std::deque<FileChunkEntry> file_queue_; // Bulk lane: written only when write_queue_ is empty
+    FramingMode write_framing_;
+    PayloadEncoding payload_encoding_;
+    bool writing_;
+    boost::asio::steady_timer write_signal_; // Cancelled to wake the writer
+
+    // Backpressure
+    OutboundLimits limits_;
+    std::atomic<std::size_t> queued_bytes_;
+    std::vector<std::weak_ptr<Session>> paused_senders_; // Waiting for our queue to drain
+    std::vector<std::function<void()>> drain_callbacks_;  // whenDrained() producers, e.g. file downloads
+    // whenWritten() callbacks with the ordinal every earlier frame is below
+    std::vector<std::pair<std::uint64_t, std::function<void()>>> written_callbacks_;
+    std::uint64_t next_ordinal_ = 0;
+    bool read_paused_;   // Reading stopped because a receiver is congested
+    boost::asio::steady_timer resume_signal_; // Cancelled to wake a paused reader
+    static OutboundStats stats_;
+
+    // Liveness: last_activity_ is refreshed on every read, the wheel timer
+    // only looks at it when it fires
+    TimingWheel& timing_wheel_;
+    TimingWheel::Timer timer_;
+    SessionTimeouts timeouts_;
+    std::chrono::steady_clock::time_point login_deadline_;
+    std::chrono::steady_clock::time_point last_activity_;
+    bool ping_sent_;
     
     // Session state
     bool closing_;
+    bool close_after_flush_; // Reading stopped, close once the writer drains the queue
 };
 
 #endif // SESSION_HPP
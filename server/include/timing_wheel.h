@@ -0,0 +1,69 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <boost/asio.hpp>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Hierarchical timing wheel shared by all sessions.
+// A single steady_timer ticks the wheel; timers are intrusive list nodes, so
+// schedule/cancel are O(1) regardless of how many connections exist.
+// Level 0 has one slot per tick, level 1 one slot per kSlots ticks; deadlines
+// beyond the wheel span are parked in the farthest slot and re-inserted later.
+class TimingWheel {
+public:
+    using Callback = std::function<void()>;
+
+    // Owned by the caller; must be cancelled before it is destroyed
+    class Timer {
+    public:
+        Timer() = default;
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        friend class TimingWheel;
+        Timer* prev_ = nullptr;
+        Timer* next_ = nullptr;
+        Timer** slot_ = nullptr;  // Head of the slot list while scheduled
+        std::uint64_t expiry_tick_ = 0;
+        Callback callback_;
+    };
+
+    TimingWheel(boost::asio::io_context& io_context, std::chrono::milliseconds tick);
+    ~TimingWheel();
+
+    void start();
+    // Safe from any thread; pending timers are never fired afterwards
+    void stop();
+
+    // (Re)arms the timer; the callback runs on an io thread, outside the wheel lock
+    void schedule(Timer& timer, std::chrono::milliseconds delay, Callback callback);
+    void cancel(Timer& timer);
+
+    std::chrono::milliseconds tick() const { return tick_; }
+
+private:
+    static constexpr std::size_t kSlots = 64;
+
+    void scheduleTick();
+    void onTick();
+    void insert(Timer& timer);
+    void unlink(Timer& timer);
+
+    boost::asio::steady_timer tick_timer_; // On its own strand: ticks and stop() never overlap
+    std::chrono::milliseconds tick_;
+    std::chrono::steady_clock::time_point next_tick_time_;
+    bool running_;
+
+    std::mutex mutex_;
+    std::uint64_t current_tick_;
+    std::array<Timer*, kSlots> level0_{};
+    std::array<Timer*, kSlots> level1_{};
+};
+
+#endif // TIMING_WHEEL_H
@@ -0,0 +1,65 @@
+#ifndef TYPING_COALESCER_H
+#define TYPING_COALESCER_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "server_config.h"
+#include "timing_wheel.h"
+
+// Per (sender, receiver) typing state between the client's events and the frames
+// actually sent. A pair's entry exists only while the receiver may be showing
+// "typing"; no entry means "not typing", so a stray "stopped" is never forwarded.
+// - A repeat of the forwarded state is dropped; a repeated "typing" goes out again
+//   once the interval has passed, so the receiver's indicator does not time out
+// - A change within the interval of the previous frame is held back, the latest
+//   one wins, and the timing wheel sends it when the interval ends
+// - "Typing" not refreshed for expiry is turned off for the receiver
+class TypingCoalescer {
+public:
+    // Sends the typing frame; called without the coalescer lock held
+    using Forward = std::function<void(const std::string& from, const std::string& to, bool is_typing)>;
+
+    TypingCoalescer(TimingWheel& timing_wheel, const TypingSettings& settings, Forward forward);
+    ~TypingCoalescer();
+
+    TypingCoalescer(const TypingCoalescer&) = delete;
+    TypingCoalescer& operator=(const TypingCoalescer&) = delete;
+
+    void update(std::string_view from, std::string_view to, bool is_typing);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct PairState {
+        std::string from;
+        std::string to;
+        bool forwarded = true;       // What the receiver was told last
+        std::optional<bool> pending; // Change held back until the interval ends
+        Clock::time_point last_forward;
+        Clock::time_point last_update; // Last event from the sender
+        std::uint64_t generation = 0;  // Stale timer callbacks are ignored
+        TimingWheel::Timer timer;
+    };
+
+    static std::string pairKey(std::string_view from, std::string_view to);
+    // Records the frame about to be sent and arms the interval timer
+    void markForwardedLocked(const std::string& key, PairState& state, bool is_typing, Clock::time_point now);
+    void armLocked(const std::string& key, PairState& state, std::chrono::milliseconds delay);
+    void onTimer(const std::string& key, std::uint64_t generation);
+
+    TimingWheel& timing_wheel_;
+    const TypingSettings settings_;
+    Forward forward_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<PairState>> pairs_; // Timers are not movable
+};
+
+#endif // TYPING_COALESCER_H
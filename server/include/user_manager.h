@@ -2,16 +2,20 @@
 #define USER_MANAGER_H
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <memory>
 #include <functional>
+#include <mutex>
+#include <vector>
 #include "database.h"
+#include "presence_manager.h"
 
 class Session; // Forward declaration
 
 class UserManager {
 public:
-    UserManager(Database& db);
+    UserManager(Database& db, PresenceManager& presence);
     ~UserManager() = default;
 
     // User authentication and registration
@@ -20,10 +24,18 @@ public:
     
     // Session management
     void addSession(int user_id, const std::string& username, std::shared_ptr<Session> session);
-    void removeSession(int user_id);
+    // expected != nullptr removes the entry only if it still points to that session,
+    // so a stale connection closing late cannot evict the user's newer login
+    void removeSession(int user_id, const Session* expected = nullptr);
     bool isSessionActive(int user_id);
     std::shared_ptr<Session> getSession(int user_id);
-    std::shared_ptr<Session> getSessionByUsername(const std::string& username);
+    std::shared_ptr<Session> getSessionByUsername(std::string_view username);
+
+    // Presence: logins/logouts of watched users are pushed to the subscriber.
+    // `online` gets the watched users online right now. False if over the subscription limit
+    bool subscribePresence(const std::shared_ptr<Session>& session, const std::vector<std::string>& usernames,
+                           std::vector<std::string>& online);
+    void unsubscribePresence(const Session* session, const std::vector<std::string>& usernames);
     
     // User information
     std::unique_ptr<User> getUser(const std::string& username);
@@ -34,8 +46,13 @@ private:
     bool verifyPassword(const std::string& password, const std::string& hash);
     
     Database& db_;
+    PresenceManager& presence_; // Notified under sessions_mutex_
+
+    // Session maps are touched from every io thread
+    mutable std::mutex sessions_mutex_;
     std::map<int, std::shared_ptr<Session>> active_sessions_;
     std::map<int, std::string> user_id_to_username_;
+    std::map<std::string, int, std::less<>> username_to_user_id_; // Online users by name, looked up with string_view
 };
 
 #endif // USER_MANAGER_HPP
@@ -1,58 +1,177 @@
 #include "include/json_parser.h"
 #include "include/session.h"
-#include <iostream>
+#include "include/logger.h"
+#include "include/fast_request_parser.h"
+#include "payload_encoding.h"
+#include "base64.h"
+#include <algorithm>
 #include <ctime>
 
 using json = nlohmann::json;
 
+namespace {
+// Only unsigned integer ids are echoed back; anything else is ignored
+RequestId requestIdOf(const json& message) {
+    auto it = message.find("id");
+    if (it != message.end() && it->is_number_unsigned()) {
+        return it->get<std::uint64_t>();
+    }
+    return std::nullopt;
+}
+}
+
 JsonParser::JsonParser(UserManager& user_manager, Router& router)
-    : user_manager_(user_manager), router_(router) {}
+    : user_manager_(user_manager), router_(router) {
+    handlers_.on(Command::Hello, &JsonParser::handleHello);
+    handlers_.on(Command::Register, &JsonParser::handleRegister);
+    handlers_.on(Command::Login, &JsonParser::handleLogin);
+    handlers_.on(Command::Message, &JsonParser::handleMessage);
+    handlers_.on(Command::Typing, &JsonParser::handleTyping);
+    handlers_.on(Command::Ack, &JsonParser::handleAck);
+    handlers_.on(Command::Subscribe, &JsonParser::handleSubscribe);
+    handlers_.on(Command::Unsubscribe, &JsonParser::handleUnsubscribe);
+    handlers_.on(Command::FileUpload, &JsonParser::handleFileUpload);
+    handlers_.on(Command::FileChunk, &JsonParser::handleFileChunk);
+    handlers_.on(Command::FileDownload, &JsonParser::handleFileDownload);
+    handlers_.on(Command::Ping, &JsonParser::handlePing);
+    handlers_.on(Command::Pong, &JsonParser::handlePong);
+}
 
-void JsonParser::parseMessage(const std::string& raw_message, std::shared_ptr<Session> session) {
+void JsonParser::parseMessage(std::string_view raw_message, std::shared_ptr<Session> session) {
     try {
+        PayloadEncoding encoding = session->getPayloadEncoding();
+        if (encoding != PayloadEncoding::Json) {
+            // Бинарные кодировки разбирает только nlohmann
+            LOG_DEBUG("received frame", "user", session->getUsername(), "encoding", encodingName(encoding),
+                      "bytes", raw_message.size());
+            handleRequest(decodePayload(raw_message, encoding), session);
+            return;
+        }
+
+        LOG_DEBUG("received frame", "user", session->getUsername(), "payload", raw_message);
+
+        // Частые запросы разбираем без DOM, остальное - через nlohmann
+        FastRequestParser fast_parser;
+        FastRequest request = fast_parser.parse(raw_message);
+        if (auto* chat = std::get_if<ChatMessageRequest>(&request)) {
+            handleMessage(*chat, session);
+            return;
+        }
+        if (auto* typing = std::get_if<TypingRequest>(&request)) {
+            handleTyping(*typing, session);
+            return;
+        }
+        if (auto* ack = std::get_if<AckRequest>(&request)) {
+            handleAck(*ack, session);
+            return;
+        }
+        if (auto* login = std::get_if<LoginRequest>(&request)) {
+            handleLogin(*login, session);
+            return;
+        }
+        if (auto* registration = std::get_if<RegisterRequest>(&request)) {
+            handleRegister(*registration, session);
+            return;
+        }
+
         json message = json::parse(raw_message);
-        std::cout << "Received message: " << message.dump() << std::endl;
-        
         handleRequest(message, session);
     } catch (const json::parse_error& e) {
-        std::cerr << "JSON parse error: " << e.what() << std::endl;
-        sendResponse(session, "error", false, "Invalid JSON format");
+        LOG_WARN("json parse error", "user", session->getUsername(), "error", e.what());
+        sendResponse(session, Command::Error, std::nullopt, false,
+                     session->getPayloadEncoding() == PayloadEncoding::Json ? "Invalid JSON format" : "Invalid payload");
     } catch (const std::exception& e) {
-        std::cerr << "Error parsing message: " << e.what() << std::endl;
-        sendResponse(session, "error", false, "Internal server error");
+        LOG_ERROR("error parsing message", "error", e.what());
+        sendResponse(session, Command::Error, std::nullopt, false, "Internal server error");
     }
 }
 
 void JsonParser::handleRequest(const json& message, std::shared_ptr<Session> session) {
     try {
         if (!message.contains("type")) {
-            sendResponse(session, "error", false, "Missing message type");
+            sendResponse(session, Command::Error, requestIdOf(message), false, "Missing message type");
             return;
         }
         
-        std::string type = message["type"];
+        const std::string& type = message["type"].get_ref<const std::string&>();
+        const RequestHandler* handler = handlers_.find(commandFromName(type));
+        if (handler == nullptr) {
+            sendResponse(session, Command::Error, requestIdOf(message), false, "Unknown message type: " + type);
+            return;
+        }
+        (this->**handler)(message, session);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error handling request", "error", e.what());
+        sendResponse(session, Command::Error, requestIdOf(message), false, "Error processing request");
+    }
+}
+
+void JsonParser::handlePing(const json&, std::shared_ptr<Session> session) {
+    json pong;
+    pong["type"] = commandName(Command::Pong);
+    pong["timestamp"] = std::time(nullptr);
+    session->send(pong);
+}
+
+void JsonParser::handlePong(const json&, std::shared_ptr<Session>) {
+    // Активность уже учтена сессией при чтении
+}
+
+void JsonParser::handleHello(const json& message, std::shared_ptr<Session> session) {
+    try {
+        // Фрейминг согласуется только в начале соединения, до логина
+        if (session->isAuthenticated() || session->getFramingMode() != FramingMode::Newline) {
+            sendResponse(session, Command::Hello, requestIdOf(message), false, "Framing can only be negotiated once, before login");
+            return;
+        }
         
-        if (type == "register") {
-            handleRegister(message, session);
-        } else if (type == "login") {
-            handleLogin(message, session);
-        } else if (type == "message") {
-            handleMessage(message, session);
-        } else if (type == "typing") {
-            handleTyping(message, session);
+        std::string framing = message.value("framing", "newline");
+        FramingMode mode;
+        if (framing == "newline") {
+            mode = FramingMode::Newline;
+        } else if (framing == "length") {
+            mode = FramingMode::LengthPrefixed;
         } else {
-            sendResponse(session, "error", false, "Unknown message type: " + type);
+            sendResponse(session, Command::Hello, requestIdOf(message), false, "Unsupported framing: " + framing);
+            return;
+        }
+
+        std::string encoding_name = message.value("encoding", "json");
+        PayloadEncoding encoding;
+        if (!parseEncodingName(encoding_name, encoding)) {
+            sendResponse(session, Command::Hello, requestIdOf(message), false, "Unsupported encoding: " + encoding_name);
+            return;
+        }
+        // В бинарных данных может встретиться '\n', поэтому нужен length-prefixed режим
+        if (encoding != PayloadEncoding::Json && mode != FramingMode::LengthPrefixed) {
+            sendResponse(session, Command::Hello, requestIdOf(message), false, "Binary encodings require length framing");
+            return;
+        }
+        
+        json response;
+        response["type"] = commandName(Command::HelloResponse);
+        response["success"] = true;
+        response["framing"] = framing;
+        response["encoding"] = encoding_name;
+        if (RequestId id = requestIdOf(message)) {
+            response["id"] = *id;
         }
+        response["timestamp"] = std::time(nullptr);
+        
+        // Ответ уходит еще в старом режиме, все последующие фреймы - в новом
+        session->send(response);
+        session->setFramingMode(mode);
+        session->setPayloadEncoding(encoding);
     } catch (const std::exception& e) {
-        std::cerr << "Error handling request: " << e.what() << std::endl;
-        sendResponse(session, "error", false, "Error processing request");
+        LOG_ERROR("error in handleHello", "error", e.what());
+        sendResponse(session, Command::Hello, requestIdOf(message), false, "Hello error");
     }
 }
 
 void JsonParser::handleRegister(const json& message, std::shared_ptr<Session> session) {
     try {
         if (!message.contains("username") || !message.contains("email") || !message.contains("password")) {
-            sendResponse(session, "register", false, "Missing required fields");
+            sendResponse(session, Command::Register, requestIdOf(message), false, "Missing required fields");
             return;
         }
         
@@ -60,72 +179,148 @@ void JsonParser::handleRegister(const json& message, std::shared_ptr<Session> se
         std::string email = message["email"];
         std::string password = message["password"];
         
-        bool success = user_manager_.registerUser(username, email, password);
+        handleRegister(RegisterRequest{username, email, password, requestIdOf(message)}, session);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleRegister", "error", e.what());
+        sendResponse(session, Command::Register, requestIdOf(message), false, "Registration error");
+    }
+}
+
+void JsonParser::handleRegister(const RegisterRequest& request, std::shared_ptr<Session> session) {
+    try {
+        bool success = user_manager_.registerUser(std::string(request.username), std::string(request.email),
+                                                  std::string(request.password));
         
         if (success) {
-            sendResponse(session, "register", true, "Registration successful");
+            sendResponse(session, Command::Register, request.id, true, "Registration successful");
         } else {
-            sendResponse(session, "register", false, "Registration failed - user may already exist");
+            sendResponse(session, Command::Register, request.id, false, "Registration failed - user may already exist");
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error in handleRegister: " << e.what() << std::endl;
-        sendResponse(session, "register", false, "Registration error");
+        LOG_ERROR("error in handleRegister", "error", e.what());
+        sendResponse(session, Command::Register, request.id, false, "Registration error");
     }
 }
 
 void JsonParser::handleLogin(const json& message, std::shared_ptr<Session> session) {
     try {
         if (!message.contains("username") || !message.contains("password")) {
-            sendResponse(session, "login", false, "Missing username or password");
+            sendResponse(session, Command::Login, requestIdOf(message), false, "Missing username or password");
             return;
         }
         
         std::string username = message["username"];
         std::string password = message["password"];
+        bool acks = message.value("acks", false);
+
+        handleLogin(LoginRequest{username, password, requestIdOf(message), acks}, session);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleLogin", "error", e.what());
+        sendResponse(session, Command::Login, requestIdOf(message), false, "Login error");
+    }
+}
+
+void JsonParser::handleLogin(const LoginRequest& request, std::shared_ptr<Session> session) {
+    try {
+        std::string username(request.username);
         int user_id;
         
-        bool success = user_manager_.authenticateUser(username, password, user_id);
+        bool success = user_manager_.authenticateUser(username, std::string(request.password), user_id);
         
         if (success) {
             // Устанавливаем аутентификацию сессии
             session->setAuthenticated(user_id, username);
+            session->setDeliveryAcks(request.acks);
             
-            // Добавляем сессию в UserManager
-            user_manager_.addSession(user_id, username, session);
-            
-            sendResponse(session, "login", true, "Login successful");
-
-            // Отправляем накопленные оффлайн-сообщения
-            std::cout << "About to send stored messages for user: " << username << " (ID: " << user_id << ")" << std::endl;
-            router_.sendStoredMessages(user_id, session);
+            if (request.acks) {
+                // Клиент с ack'ами узнает, докуда он уже подтвердил каждый входящий поток,
+                // и по ним отбрасывает повторно доставленные сообщения. Ack'и прошлой сессии
+                // могут еще стоять в очереди записи - отвечаем после ее коммита
+                RequestId id = request.id;
+                std::weak_ptr<Session> weak_session = session;
+                router_.afterQueuedWrites(session, [this, weak_session, id, user_id, username]() {
+                    auto session = weak_session.lock();
+                    if (!session) {
+                        return;
+                    }
+                    try {
+                        json response;
+                        response["type"] = commandName(Command::LoginResponse);
+                        if (id) {
+                            response["id"] = *id;
+                        }
+                        response["success"] = true;
+                        response["message"] = "Login successful";
+                        json acked = json::object();
+                        for (const auto& watermark : router_.ackWatermarks(user_id)) {
+                            acked[watermark.sender] = watermark.acked_seq;
+                        }
+                        response["acked"] = std::move(acked);
+                        response["timestamp"] = std::time(nullptr);
+                        session->send(response);
+                        finishLogin(user_id, username, session);
+                    } catch (const std::exception& e) {
+                        LOG_ERROR("error in handleLogin", "error", e.what());
+                        sendResponse(session, Command::Login, id, false, "Login error");
+                    }
+                });
+            } else {
+                sendResponse(session, Command::Login, request.id, true, "Login successful");
+                finishLogin(user_id, username, session);
+            }
         } else {
-            sendResponse(session, "login", false, "Invalid username or password");
+            sendResponse(session, Command::Login, request.id, false, "Invalid username or password");
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error in handleLogin: " << e.what() << std::endl;
-        sendResponse(session, "login", false, "Login error");
+        LOG_ERROR("error in handleLogin", "error", e.what());
+        sendResponse(session, Command::Login, request.id, false, "Login error");
     }
 }
 
+void JsonParser::finishLogin(int user_id, const std::string& username, const std::shared_ptr<Session>& session) {
+    // Онлайн только после ответа: живые сообщения не обгонят login_response
+    user_manager_.addSession(user_id, username, session);
+
+    // Отправляем накопленные оффлайн-сообщения
+    router_.sendStoredMessages(user_id, session);
+}
+
 void JsonParser::handleMessage(const json& message, std::shared_ptr<Session> session) {
     try {
         if (!isSessionAuthenticated(session)) {
-            sendResponse(session, "message", false, "Not authenticated");
+            sendResponse(session, Command::Message, requestIdOf(message), false, "Not authenticated");
             return;
         }
         
         if (!message.contains("to") || !message.contains("content")) {
-            sendResponse(session, "message", false, "Missing recipient or content");
+            sendResponse(session, Command::Message, requestIdOf(message), false, "Missing recipient or content");
             return;
         }
         
+        std::string to = message["to"];
+        std::string content = message["content"];
+
+        handleMessage(ChatMessageRequest{to, content, requestIdOf(message)}, session);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleMessage", "error", e.what());
+        sendResponse(session, Command::Message, requestIdOf(message), false, "Message delivery error");
+    }
+}
+
+void JsonParser::handleMessage(const ChatMessageRequest& request, std::shared_ptr<Session> session) {
+    try {
+        if (!isSessionAuthenticated(session)) {
+            sendResponse(session, Command::Message, request.id, false, "Not authenticated");
+            return;
+        }
+
         // Передаем сообщение в Router для маршрутизации
-        router_.routeMessage(message, session, session->getUserId());
+        router_.routeMessage(request, session, session->getUserId());
         
-        sendResponse(session, "message", true, "Message sent");
+        sendResponse(session, Command::Message, request.id, true, "Message sent");
     } catch (const std::exception& e) {
-        std::cerr << "Error in handleMessage: " << e.what() << std::endl;
-        sendResponse(session, "message", false, "Message delivery error");
+        LOG_ERROR("error in handleMessage", "error", e.what());
+        sendResponse(session, Command::Message, request.id, false, "Message delivery error");
     }
 }
 
@@ -142,12 +337,292 @@ void JsonParser::handleTyping(const json& message, std::shared_ptr<Session> sess
         std::string to_username = message["to"];
         bool is_typing = message["is_typing"];
         
-        router_.sendTypingStatus(session->getUsername(), to_username, is_typing);
+        handleTyping(TypingRequest{to_username, is_typing, requestIdOf(message)}, session);
     } catch (const std::exception& e) {
-        std::cerr << "Error in handleTyping: " << e.what() << std::endl;
+        LOG_ERROR("error in handleTyping", "error", e.what());
     }
 }
 
+void JsonParser::handleTyping(const TypingRequest& request, std::shared_ptr<Session> session) {
+    try {
+        if (!isSessionAuthenticated(session)) {
+            return; // Игнорируем typing от неаутентифицированных пользователей
+        }
+
+        router_.sendTypingStatus(session->getUsername(), request.to, request.is_typing);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleTyping", "error", e.what());
+    }
+}
+
+void JsonParser::handleAck(const json& message, std::shared_ptr<Session> session) {
+    try {
+        if (!message.contains("from") || !message.contains("seq") || !message["seq"].is_number_unsigned()) {
+            return; // Некорректный ack просто игнорируем, ответа на ack нет
+        }
+
+        std::string from = message["from"];
+        handleAck(AckRequest{from, message["seq"].get<std::uint64_t>(), requestIdOf(message)}, session);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleAck", "error", e.what());
+    }
+}
+
+void JsonParser::handleAck(const AckRequest& request, std::shared_ptr<Session> session) {
+    try {
+        if (!isSessionAuthenticated(session)) {
+            return;
+        }
+
+        router_.acknowledge(session->getUserId(), request.from, request.seq);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleAck", "error", e.what());
+    }
+}
+
+void JsonParser::handleSubscribe(const json& message, std::shared_ptr<Session> session) {
+    try {
+        if (!isSessionAuthenticated(session)) {
+            sendResponse(session, Command::Subscribe, requestIdOf(message), false, "Not authenticated");
+            return;
+        }
+
+        std::vector<std::string> users;
+        if (!presenceUsers(message, users)) {
+            sendResponse(session, Command::Subscribe, requestIdOf(message), false, "Missing users list");
+            return;
+        }
+
+        std::vector<std::string> online;
+        if (!user_manager_.subscribePresence(session, users, online)) {
+            sendResponse(session, Command::Subscribe, requestIdOf(message), false, "Too many presence subscriptions");
+            return;
+        }
+
+        // Текущее состояние приходит в ответе, дальше - только изменения в "presence"
+        json response;
+        response["type"] = commandName(Command::SubscribeResponse);
+        if (auto id = requestIdOf(message)) {
+            response["id"] = *id;
+        }
+        response["success"] = true;
+        response["message"] = "Subscribed";
+        response["online"] = std::move(online);
+        response["timestamp"] = std::time(nullptr);
+        session->send(response);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleSubscribe", "error", e.what());
+        sendResponse(session, Command::Subscribe, requestIdOf(message), false, "Subscribe error");
+    }
+}
+
+void JsonParser::handleUnsubscribe(const json& message, std::shared_ptr<Session> session) {
+    try {
+        if (!isSessionAuthenticated(session)) {
+            sendResponse(session, Command::Unsubscribe, requestIdOf(message), false, "Not authenticated");
+            return;
+        }
+
+        std::vector<std::string> users;
+        if (!presenceUsers(message, users)) {
+            sendResponse(session, Command::Unsubscribe, requestIdOf(message), false, "Missing users list");
+            return;
+        }
+
+        user_manager_.unsubscribePresence(session.get(), users);
+        sendResponse(session, Command::Unsubscribe, requestIdOf(message), true, "Unsubscribed");
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleUnsubscribe", "error", e.what());
+        sendResponse(session, Command::Unsubscribe, requestIdOf(message), false, "Unsubscribe error");
+    }
+}
+
+void JsonParser::handleFileUpload(const json& message, std::shared_ptr<Session> session) {
+    try {
+        if (!isSessionAuthenticated(session)) {
+            sendResponse(session, Command::FileUpload, requestIdOf(message), false, "Not authenticated");
+            return;
+        }
+
+        FileRecord file;
+        std::uint64_t received = 0;
+        std::string error;
+        if (message.contains("file_id")) {
+            // Докачка: клиент продолжит с offset из ответа
+            if (!message["file_id"].is_string() ||
+                !router_.resumeUpload(session->getUserId(), message["file_id"].get<std::string>(), file, received, error)) {
+                sendResponse(session, Command::FileUpload, requestIdOf(message), false,
+                             error.empty() ? "Invalid file_id" : error);
+                return;
+            }
+        } else {
+            if (!message.contains("to") || !message["to"].is_string() ||
+                !message.contains("name") || !message["name"].is_string() ||
+                !message.contains("size") || !message["size"].is_number_unsigned()) {
+                sendResponse(session, Command::FileUpload, requestIdOf(message), false, "Missing to, name or size");
+                return;
+            }
+            if (!router_.beginUpload(session->getUserId(), message["to"].get<std::string>(),
+                                     message["name"].get<std::string>(), message["size"].get<std::uint64_t>(),
+                                     file, error)) {
+                sendResponse(session, Command::FileUpload, requestIdOf(message), false, error);
+                return;
+            }
+        }
+
+        json response;
+        response["type"] = commandName(Command::FileUploadResponse);
+        if (auto id = requestIdOf(message)) {
+            response["id"] = *id;
+        }
+        response["success"] = true;
+        response["file_id"] = file.id;
+        response["size"] = file.size;
+        response["offset"] = received;
+        response["chunk_size"] = router_.uploadChunkSize(session->getPayloadEncoding());
+        response["timestamp"] = std::time(nullptr);
+        session->send(response);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleFileUpload", "error", e.what());
+        sendResponse(session, Command::FileUpload, requestIdOf(message), false, "Upload error");
+    }
+}
+
+void JsonParser::handleFileChunk(const json& message, std::shared_ptr<Session> session) {
+    try {
+        if (!isSessionAuthenticated(session)) {
+            sendResponse(session, Command::FileChunk, requestIdOf(message), false, "Not authenticated");
+            return;
+        }
+
+        std::string data;
+        if (!message.contains("file_id") || !message["file_id"].is_string() ||
+            !message.contains("offset") || !message["offset"].is_number_unsigned() ||
+            !fileChunkData(message, data)) {
+            sendResponse(session, Command::FileChunk, requestIdOf(message), false, "Missing file_id, offset or data");
+            return;
+        }
+
+        std::string file_id = message["file_id"].get<std::string>();
+        std::uint64_t received = 0;
+        auto result = router_.receiveFileChunk(session, file_id, message["offset"].get<std::uint64_t>(), data, received);
+
+        json response;
+        response["type"] = commandName(Command::FileChunkResponse);
+        if (auto id = requestIdOf(message)) {
+            response["id"] = *id;
+        }
+        response["file_id"] = file_id;
+        response["offset"] = received; // С него клиент шлет следующий чанк
+        switch (result) {
+            case FileStore::ChunkResult::Accepted:
+            case FileStore::ChunkResult::Completed:
+                response["success"] = true;
+                response["complete"] = result == FileStore::ChunkResult::Completed;
+                break;
+            case FileStore::ChunkResult::WrongOffset:
+                response["success"] = false;
+                response["message"] = "Unexpected offset";
+                break;
+            case FileStore::ChunkResult::TooLarge:
+                response["success"] = false;
+                response["message"] = "Chunk exceeds file size";
+                break;
+            case FileStore::ChunkResult::UnknownFile:
+                response["success"] = false;
+                response["message"] = "Unknown upload";
+                break;
+            case FileStore::ChunkResult::Failed:
+                response["success"] = false;
+                response["message"] = "Failed to store chunk";
+                break;
+        }
+        response["timestamp"] = std::time(nullptr);
+        session->send(response);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleFileChunk", "error", e.what());
+        sendResponse(session, Command::FileChunk, requestIdOf(message), false, "Chunk error");
+    }
+}
+
+void JsonParser::handleFileDownload(const json& message, std::shared_ptr<Session> session) {
+    try {
+        if (!isSessionAuthenticated(session)) {
+            sendResponse(session, Command::FileDownload, requestIdOf(message), false, "Not authenticated");
+            return;
+        }
+
+        if (!message.contains("file_id") || !message["file_id"].is_string()) {
+            sendResponse(session, Command::FileDownload, requestIdOf(message), false, "Missing file_id");
+            return;
+        }
+        std::uint64_t offset = 0;
+        if (message.contains("offset")) {
+            if (!message["offset"].is_number_unsigned()) {
+                sendResponse(session, Command::FileDownload, requestIdOf(message), false, "Invalid offset");
+                return;
+            }
+            offset = message["offset"].get<std::uint64_t>();
+        }
+
+        FileRecord file;
+        std::string error;
+        auto blob = router_.openDownload(session->getUserId(), message["file_id"].get<std::string>(), file, error);
+        if (blob == nullptr) {
+            sendResponse(session, Command::FileDownload, requestIdOf(message), false, error);
+            return;
+        }
+
+        // Ответ идет раньше чанков: они ставятся в очередь после него
+        json response;
+        response["type"] = commandName(Command::FileDownloadResponse);
+        if (auto id = requestIdOf(message)) {
+            response["id"] = *id;
+        }
+        response["success"] = true;
+        response["file_id"] = file.id;
+        response["name"] = file.name;
+        response["size"] = file.size;
+        response["offset"] = std::min(offset, file.size);
+        response["timestamp"] = std::time(nullptr);
+        session->send(response);
+
+        router_.sendFile(session, std::move(file), std::move(blob), offset);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error in handleFileDownload", "error", e.what());
+        sendResponse(session, Command::FileDownload, requestIdOf(message), false, "Download error");
+    }
+}
+
+bool JsonParser::fileChunkData(const json& message, std::string& data) {
+    auto it = message.find("data");
+    if (it == message.end()) {
+        return false;
+    }
+    if (it->is_binary()) {
+        const auto& bytes = it->get_binary();
+        data.assign(bytes.begin(), bytes.end());
+        return true;
+    }
+    return it->is_string() && base64Decode(it->get_ref<const std::string&>(), data);
+}
+
+bool JsonParser::presenceUsers(const json& message, std::vector<std::string>& users) {
+    auto it = message.find("users");
+    if (it == message.end() || !it->is_array()) {
+        return false;
+    }
+    users.clear();
+    users.reserve(it->size());
+    for (const auto& user : *it) {
+        if (!user.is_string()) {
+            return false;
+        }
+        users.push_back(user.get<std::string>());
+    }
+    return true;
+}
+
 bool JsonParser::isSessionAuthenticated(std::shared_ptr<Session> session) {
     if (!session->isAuthenticated()) {
         return false;
@@ -157,20 +632,23 @@ bool JsonParser::isSessionAuthenticated(std::shared_ptr<Session> session) {
     return user_manager_.isSessionActive(session->getUserId());
 }
 
-void JsonParser::sendResponse(std::shared_ptr<Session> session, const std::string& type, bool success, const std::string& message) {
+void JsonParser::sendResponse(std::shared_ptr<Session> session, Command request, RequestId id, bool success, const std::string& message) {
     try {
         json response;
-        response["type"] = type + "_response";
+        response["type"] = commandName(responseFor(request));
+        if (id) {
+            response["id"] = *id;
+        }
         response["success"] = success;
         response["message"] = message;
         response["timestamp"] = std::time(nullptr);
         
         session->send(response);
     } catch (const std::exception& e) {
-        std::cerr << "Error sending response: " << e.what() << std::endl;
+        LOG_ERROR("error sending response", "error", e.what());
     }
 }
 
-void JsonParser::removeSessionFromManager(int user_id) {
-    user_manager_.removeSession(user_id);
+void JsonParser::removeSessionFromManager(int user_id, const Session* session) {
+    user_manager_.removeSession(user_id, session);
 }
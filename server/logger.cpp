@@ -0,0 +1,152 @@
+#include "include/logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+namespace {
+constexpr std::size_t kRingMask = Logger::kRingSize - 1;
+static_assert((Logger::kRingSize & kRingMask) == 0, "ring size must be a power of two");
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO ";
+        case LogLevel::Warn: return "WARN ";
+        case LogLevel::Error: return "ERROR";
+    }
+    return "?    ";
+}
+
+void appendTimestamp(std::string& out, std::chrono::system_clock::time_point time) {
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+    std::tm tm{};
+#ifdef _WIN32
+    gmtime_s(&tm, &seconds);
+#else
+    gmtime_r(&seconds, &tm);
+#endif
+    char buffer[32];
+    std::size_t n = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &tm);
+    out.append(buffer, n);
+    n = std::snprintf(buffer, sizeof(buffer), ".%03dZ ", static_cast<int>(millis));
+    out.append(buffer, n);
+}
+}
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : ring_(new Slot[kRingSize]), enqueue_pos_(0), dequeue_pos_(0),
+      level_(std::max(kCompiledLogLevel, LogLevel::Info)), dropped_(0), running_(false) {
+    for (std::size_t i = 0; i < kRingSize; ++i) {
+        ring_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+Logger::~Logger() {
+    stop();
+}
+
+bool Logger::parseLevel(std::string_view name, LogLevel& level) {
+    if (name == "debug") {
+        level = LogLevel::Debug;
+    } else if (name == "info") {
+        level = LogLevel::Info;
+    } else if (name == "warn") {
+        level = LogLevel::Warn;
+    } else if (name == "error") {
+        level = LogLevel::Error;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void Logger::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+    thread_ = std::thread([this]() { run(); });
+}
+
+void Logger::stop() {
+    if (running_.exchange(false) && thread_.joinable()) {
+        thread_.join();
+    }
+    drainBatch(); // Записи, сделанные после остановки потока
+}
+
+Logger::Slot* Logger::acquire(std::size_t& position) {
+    // Классическая bounded-очередь Вьюкова: слот свободен, когда его sequence == position
+    std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot* slot = &ring_[pos & kRingMask];
+        std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                position = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            return nullptr; // Кольцо заполнено
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool Logger::drainBatch() {
+    std::string out;
+    std::string err;
+    std::size_t drained = 0;
+
+    while (drained < kRingSize) {
+        Slot& slot = ring_[dequeue_pos_ & kRingMask];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+            break;
+        }
+
+        std::string& target = slot.level >= LogLevel::Warn ? err : out;
+        appendTimestamp(target, slot.time);
+        target += levelName(slot.level);
+        target += ' ';
+        target.append(slot.text, slot.length);
+        target += '\n';
+
+        slot.sequence.store(dequeue_pos_ + kRingSize, std::memory_order_release);
+        ++dequeue_pos_;
+        ++drained;
+    }
+
+    if (!out.empty()) {
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+    }
+    if (!err.empty()) {
+        std::fwrite(err.data(), 1, err.size(), stderr);
+        std::fflush(stderr);
+    }
+    return drained != 0;
+}
+
+void Logger::run() {
+    std::uint64_t reported_drops = 0;
+    while (running_.load(std::memory_order_relaxed)) {
+        if (!drainBatch()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        std::uint64_t drops = dropped_.load(std::memory_order_relaxed);
+        if (drops != reported_drops) {
+            std::fprintf(stderr, "Logger: %llu records dropped, ring was full\n",
+                         static_cast<unsigned long long>(drops - reported_drops));
+            reported_drops = drops;
+        }
+    }
+}
@@ -0,0 +1,202 @@
+#include "include/message_writer.h"
+#include "include/logger.h"
+#include <algorithm>
+#include <iterator>
+
+MessageWriter::MessageWriter(Database& db, const PersistenceSettings& settings)
+    : db_(db),
+      settings_(settings),
+      enqueued_count_(0),
+      committed_count_(0),
+      running_(false),
+      stopping_(false) {}
+
+MessageWriter::~MessageWriter() {
+    stop();
+}
+
+void MessageWriter::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    stopping_ = false;
+    thread_ = std::thread([this]() { run(); });
+}
+
+void MessageWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+
+    std::vector<CommitWaiter> waiters;
+    std::uint64_t committed_count;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        waiters.swap(commit_waiters_); // Пришли, пока поток завершался
+        committed_count = committed_count_;
+    }
+    for (auto& waiter : waiters) {
+        waiter.callback(waiter.committed && committed_count >= waiter.target);
+    }
+}
+
+void MessageWriter::enqueue(NewMessage message) {
+    bool wake_writer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(std::move(message));
+        ++enqueued_count_;
+        // Первая строка запускает отсчет flush_interval, полная пачка - немедленную запись
+        std::size_t pending = pendingCountLocked();
+        wake_writer = pending == 1 || pending >= settings_.max_batch;
+    }
+    if (wake_writer) {
+        wake_.notify_one();
+    }
+}
+
+void MessageWriter::enqueueAck(const DeliveryAck& ack) {
+    bool wake_writer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        mergeAckLocked(ack);
+        ++enqueued_count_;
+        std::size_t pending = pendingCountLocked();
+        wake_writer = pending == 1 || pending >= settings_.max_batch;
+    }
+    if (wake_writer) {
+        wake_.notify_one();
+    }
+}
+
+void MessageWriter::mergeAckLocked(const DeliveryAck& ack) {
+    std::uint64_t key = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(ack.receiver_id)) << 32) |
+                        static_cast<std::uint32_t>(ack.sender_id);
+    auto [it, inserted] = pending_acks_.try_emplace(key, ack);
+    if (!inserted && ack.seq > it->second.seq) {
+        it->second.seq = ack.seq;
+    }
+}
+
+std::vector<DeliveryAck> MessageWriter::takeAcksLocked() {
+    std::vector<DeliveryAck> acks;
+    acks.reserve(pending_acks_.size());
+    for (const auto& entry : pending_acks_) {
+        acks.push_back(entry.second);
+    }
+    pending_acks_.clear();
+    return acks;
+}
+
+void MessageWriter::whenCommitted(CommitCallback callback) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (committed_count_ >= enqueued_count_) {
+        lock.unlock();
+        callback(true);
+        return;
+    }
+    if (!running_) {
+        // Потока нет - пишем сами
+        std::vector<NewMessage> batch;
+        batch.swap(pending_);
+        std::vector<DeliveryAck> acks = takeAcksLocked();
+        bool committed = db_.commitBatch(batch, acks);
+        if (!committed) {
+            LOG_ERROR("failed to commit message batch, dropped", "count", batch.size(), "acks", acks.size());
+        }
+        committed_count_ = enqueued_count_;
+        lock.unlock();
+        callback(committed);
+        return;
+    }
+
+    commit_waiters_.push_back(CommitWaiter{enqueued_count_, true, std::move(callback)});
+    lock.unlock();
+    wake_.notify_one(); // Ждущий коммита не должен ждать flush_interval
+}
+
+std::vector<MessageWriter::CommitWaiter> MessageWriter::finishBatchLocked(std::uint64_t last, bool committed) {
+    committed_count_ = last;
+    if (!committed) {
+        // Все, кто уже ждет, ждали и строк из потерянной пачки
+        for (auto& waiter : commit_waiters_) {
+            waiter.committed = false;
+        }
+    }
+    std::vector<CommitWaiter> done;
+    auto it = commit_waiters_.begin();
+    for (; it != commit_waiters_.end() && it->target <= last; ++it) {
+        done.push_back(std::move(*it));
+    }
+    commit_waiters_.erase(commit_waiters_.begin(), it);
+    return done;
+}
+
+void MessageWriter::run() {
+    std::vector<NewMessage> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this]() { return stopping_ || hasPendingLocked(); });
+        if (!hasPendingLocked()) {
+            break; // stopping_ и писать нечего
+        }
+
+        // Ждем добора пачки, но не дольше flush_interval
+        wake_.wait_for(lock, settings_.flush_interval, [this]() {
+            return stopping_ || !commit_waiters_.empty() || pendingCountLocked() >= settings_.max_batch;
+        });
+
+        batch.swap(pending_);
+        std::vector<DeliveryAck> acks = takeAcksLocked();
+        std::uint64_t batch_end = enqueued_count_;
+        lock.unlock();
+
+        bool committed = commitWithRetry(batch, acks);
+        if (committed) {
+            LOG_DEBUG("message batch committed", "count", batch.size(), "acks", acks.size());
+        }
+        batch.clear();
+
+        lock.lock();
+        std::vector<CommitWaiter> done = finishBatchLocked(batch_end, committed);
+        if (!done.empty()) {
+            lock.unlock();
+            for (auto& waiter : done) {
+                waiter.callback(waiter.committed);
+            }
+            lock.lock();
+        }
+    }
+}
+
+bool MessageWriter::commitWithRetry(const std::vector<NewMessage>& batch, const std::vector<DeliveryAck>& acks) {
+    // Отправители уже получили подтверждение - временная ошибка (занятая БД)
+    // не должна терять пачку; постоянная (полный диск) не должна вешать запись навсегда
+    auto backoff = kRetryBackoffMin;
+    for (std::size_t attempt = 1; !db_.commitBatch(batch, acks); ++attempt) {
+        bool stopping;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping = stopping_;
+        }
+        if (attempt >= (stopping ? kStopRetries : kMaxRetries)) {
+            LOG_ERROR("giving up on message batch, rows dropped", "count", batch.size(), "acks", acks.size(),
+                      "attempts", attempt);
+            return false;
+        }
+        LOG_ERROR("failed to commit message batch, retrying", "count", batch.size(), "acks", acks.size(),
+                  "attempt", attempt, "retry_in_ms", backoff.count());
+        std::this_thread::sleep_for(backoff);
+        backoff = std::min(backoff * 2, kRetryBackoffMax);
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#include "include/outbound_frame.h"
+
+OutboundFrame::OutboundFrame(nlohmann::json message)
+    : message_(std::move(message)), from_text_(false) {}
+
+OutboundFrame::OutboundFrame(JsonText json)
+    : from_text_(true) {
+    auto index = static_cast<std::size_t>(PayloadEncoding::Json);
+    encoded_[index] = std::move(json.text);
+    encoded_[index] += '\n';
+}
+
+std::shared_ptr<const OutboundFrame> OutboundFrame::fromJson(nlohmann::json message) {
+    return std::make_shared<const OutboundFrame>(std::move(message));
+}
+
+std::shared_ptr<const OutboundFrame> OutboundFrame::fromJsonText(std::string text) {
+    return std::make_shared<const OutboundFrame>(JsonText{std::move(text)});
+}
+
+std::string_view OutboundFrame::payload(PayloadEncoding encoding) const {
+    std::string_view data = encoded(encoding);
+    if (encoding == PayloadEncoding::Json) {
+        data.remove_suffix(1);
+    }
+    return data;
+}
+
+std::string_view OutboundFrame::newlineTerminated() const {
+    return encoded(PayloadEncoding::Json);
+}
+
+const std::string& OutboundFrame::encoded(PayloadEncoding encoding) const {
+    auto index = static_cast<std::size_t>(encoding);
+    // Фрейм могут одновременно отправлять сессии на разных io-потоках
+    std::call_once(once_[index], [this, encoding, index]() {
+        if (from_text_) {
+            // JSON-текст уже готов, бинарные кодировки получают его разбором
+            if (encoding != PayloadEncoding::Json) {
+                encoded_[index] = encodePayload(nlohmann::json::parse(payload(PayloadEncoding::Json)), encoding);
+            }
+            return;
+        }
+        encoded_[index] = encodePayload(message_, encoding);
+        if (encoding == PayloadEncoding::Json) {
+            // Разделитель храним сразу, чтобы newline-сессиям не копировать payload
+            encoded_[index] += '\n';
+        }
+    });
+    return encoded_[index];
+}
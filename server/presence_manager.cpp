@@ -0,0 +1,168 @@
+#include "include/presence_manager.h"
+#include "include/session.h"
+#include "include/logger.h"
+#include "commands.h"
+#include <nlohmann/json.hpp>
+#include <ctime>
+
+using json = nlohmann::json;
+
+PresenceManager::PresenceManager(TimingWheel& timing_wheel, const PresenceSettings& settings)
+    : timing_wheel_(timing_wheel), settings_(settings), flush_scheduled_(false) {}
+
+PresenceManager::~PresenceManager() {
+    timing_wheel_.cancel(flush_timer_);
+}
+
+bool PresenceManager::subscribe(const std::shared_ptr<Session>& subscriber,
+                                const std::vector<std::pair<std::string, bool>>& users) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Session* key = subscriber.get();
+    Subscriber& entry = subscribers_[key];
+
+    std::size_t added = 0;
+    for (const auto& [username, online] : users) {
+        added += entry.watched.count(username) == 0 ? 1 : 0;
+    }
+    if (entry.watched.size() + added > settings_.max_subscriptions) {
+        if (entry.watched.empty()) {
+            subscribers_.erase(key);
+        }
+        return false;
+    }
+
+    entry.session = subscriber;
+    for (const auto& [username, online] : users) {
+        // Подписчик только что получил актуальное состояние, накопленное ему уже не нужно
+        entry.watched[username] = online;
+        entry.pending.erase(username);
+        watchers_[username].insert(key);
+    }
+    return true;
+}
+
+void PresenceManager::unsubscribe(const Session* subscriber, const std::vector<std::string>& usernames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = subscribers_.find(subscriber);
+    if (it == subscribers_.end()) {
+        return;
+    }
+
+    for (const auto& username : usernames) {
+        if (it->second.watched.erase(username) != 0) {
+            it->second.pending.erase(username);
+            unwatchLocked(subscriber, username);
+        }
+    }
+    if (it->second.watched.empty()) {
+        subscribers_.erase(it);
+    }
+}
+
+void PresenceManager::removeSubscriber(const Session* subscriber) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = subscribers_.find(subscriber);
+    if (it == subscribers_.end()) {
+        return;
+    }
+
+    for (const auto& [username, online] : it->second.watched) {
+        unwatchLocked(subscriber, username);
+    }
+    subscribers_.erase(it);
+}
+
+void PresenceManager::publish(const std::string& username, bool online) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto watchers = watchers_.find(username);
+    if (watchers == watchers_.end()) {
+        return; // Никто не подписан - ничего не делаем
+    }
+
+    for (const Session* key : watchers->second) {
+        Subscriber& entry = subscribers_[key];
+        entry.pending[username] = online;
+        if (!entry.dirty) {
+            entry.dirty = true;
+            dirty_.push_back(key);
+        }
+    }
+    scheduleFlushLocked();
+}
+
+void PresenceManager::unwatchLocked(const Session* subscriber, const std::string& username) {
+    auto watchers = watchers_.find(username);
+    if (watchers == watchers_.end()) {
+        return;
+    }
+    watchers->second.erase(subscriber);
+    if (watchers->second.empty()) {
+        watchers_.erase(watchers);
+    }
+}
+
+void PresenceManager::scheduleFlushLocked() {
+    if (flush_scheduled_) {
+        return;
+    }
+    flush_scheduled_ = true;
+    timing_wheel_.schedule(flush_timer_, settings_.flush_interval, [this]() { flush(); });
+}
+
+void PresenceManager::flush() {
+    struct Batch {
+        std::weak_ptr<Session> session;
+        std::vector<std::string> online;
+        std::vector<std::string> offline;
+    };
+    std::vector<Batch> batches;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flush_scheduled_ = false;
+
+        for (const Session* key : dirty_) {
+            auto it = subscribers_.find(key);
+            if (it == subscribers_.end() || !it->second.dirty) {
+                continue; // Отписался или уже собран (адрес сессии переиспользован)
+            }
+            Subscriber& entry = it->second;
+            entry.dirty = false;
+
+            Batch batch{entry.session, {}, {}};
+            for (const auto& [username, online] : entry.pending) {
+                auto watched = entry.watched.find(username);
+                if (watched == entry.watched.end() || watched->second == online) {
+                    continue; // Вышел и вернулся между отправками - подписчику нечего сообщать
+                }
+                watched->second = online;
+                (online ? batch.online : batch.offline).push_back(username);
+            }
+            entry.pending.clear();
+
+            if (!batch.online.empty() || !batch.offline.empty()) {
+                batches.push_back(std::move(batch));
+            }
+        }
+        dirty_.clear();
+    }
+
+    // Отправляем без блокировки: send() берет мьютекс сессии
+    for (auto& batch : batches) {
+        auto session = batch.session.lock();
+        if (session == nullptr) {
+            continue;
+        }
+        try {
+            json frame;
+            frame["type"] = commandName(Command::Presence);
+            frame["online"] = std::move(batch.online);
+            frame["offline"] = std::move(batch.offline);
+            frame["timestamp"] = std::time(nullptr);
+            session->send(frame);
+        } catch (const std::exception& e) {
+            LOG_ERROR("error sending presence update", "error", e.what());
+        }
+    }
+    LOG_DEBUG("presence flushed", "subscribers", batches.size());
+}
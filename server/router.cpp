@@ -1,83 +1,165 @@
 #include "include/router.h"
 #include "include/session.h"
-#include <iostream>
+#include "include/outbound_frame.h"
+#include "commands.h"
+#include "include/logger.h"
+#include "base64.h"
+#include <algorithm>
+#include <cstdio>
 #include <ctime>
+#include <unordered_map>
 
 using json = nlohmann::json;
 
-Router::Router(Database& db, UserManager& user_manager) 
-    : db_(db), user_manager_(user_manager) {}
+namespace {
 
-void Router::routeMessage(const json& message, std::shared_ptr<Session> sender_session, int sender_user_id) {
+void appendJsonString(std::string& out, std::string_view value) {
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[7];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    out += escaped;
+                } else {
+                    out += c; // UTF-8 идет как есть, как и в json::dump
+                }
+        }
+    }
+    out += '"';
+}
+
+// Typing-фрейм собирается напрямую в текст: он эфемерный и самый частый, DOM ему не нужен
+std::string typingFrameText(std::string_view from_username, bool is_typing) {
+    std::string text;
+    text.reserve(64 + from_username.size());
+    text += "{\"type\":";
+    appendJsonString(text, commandName(Command::Typing));
+    text += ",\"from\":";
+    appendJsonString(text, from_username);
+    text += is_typing ? ",\"is_typing\":true" : ",\"is_typing\":false";
+    text += ",\"timestamp\":";
+    text += std::to_string(std::time(nullptr));
+    text += '}';
+    return text;
+}
+
+} // namespace
+
+Router::Router(Database& db, UserManager& user_manager, MessageWriter& message_writer, FileStore& file_store,
+               TimingWheel& timing_wheel, const TypingSettings& typing_settings)
+    : db_(db), user_manager_(user_manager), message_writer_(message_writer), file_store_(file_store),
+      timing_wheel_(timing_wheel),
+      stream_epoch_(0),
+      stream_eviction_at_(kMinStreamsToEvict),
+      stream_eviction_scheduled_(false),
+      typing_(timing_wheel, typing_settings,
+              [this](const std::string& from, const std::string& to, bool is_typing) {
+                  forwardTypingStatus(from, to, is_typing);
+              }),
+      file_reads_(kFileReadThreads) {}
+
+Router::~Router() {
+    timing_wheel_.cancel(stream_eviction_timer_);
+}
+
+void Router::routeMessage(const ChatMessageRequest& message, std::shared_ptr<Session> sender_session, int sender_user_id) {
     try {
-        std::string message_type = message["type"];
-        
-        if (message_type == "message") {
-            std::string receiver_username = message["to"];
-            deliverMessage(message, sender_user_id, receiver_username);
-        } else {
-            // Обработка других типов сообщений, которые реализую позже
-            std::cerr << "Unknown message type: " << message_type << std::endl;
+        // Групповые чаты и другие типы доставки появятся здесь позже
+        deliverMessage(message, sender_session, sender_user_id);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error routing message", "error", e.what());
+    }
+}
+
+void Router::sendTypingStatus(const std::string& from_username, std::string_view to_username, bool is_typing) {
+    try {
+        // Офлайн-получателю статус не нужен: не заводим состояние и таймер на любое имя
+        if (user_manager_.getSessionByUsername(to_username) == nullptr) {
+            return;
         }
+        typing_.update(from_username, to_username, is_typing);
     } catch (const std::exception& e) {
-        std::cerr << "Error routing message: " << e.what() << std::endl;
+        LOG_ERROR("error sending typing status", "error", e.what());
     }
 }
 
-void Router::sendTypingStatus(const std::string& from_username, const std::string& to_username, bool is_typing) {
+void Router::forwardTypingStatus(const std::string& from_username, const std::string& to_username, bool is_typing) {
     try {
         auto receiver_session = user_manager_.getSessionByUsername(to_username);
         
         if (receiver_session != nullptr) {
-            json typing_message;
-            typing_message["type"] = "typing";
-            typing_message["from"] = from_username;
-            typing_message["is_typing"] = is_typing;
-            typing_message["timestamp"] = std::time(nullptr);
-            
-            receiver_session->send(typing_message);
-            std::cout << "Typing status sent from " << from_username << " to " << to_username << std::endl;
+            receiver_session->send(OutboundFrame::fromJsonText(typingFrameText(from_username, is_typing)),
+                                   SendPriority::Droppable);
+            LOG_DEBUG("typing status sent", "from", from_username, "to", to_username);
         } else {
-            std::cout << "User " << to_username << " is offline, typing status not sent" << std::endl;
+            LOG_DEBUG("typing status not sent, receiver offline", "from", from_username, "to", to_username);
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error sending typing status: " << e.what() << std::endl;
+        LOG_ERROR("error sending typing status", "error", e.what());
     }
 }
 
-void Router::deliverMessage(const json& message, int sender_id, const std::string& receiver_username) {
+void Router::deliverMessage(const ChatMessageRequest& message, std::shared_ptr<Session> sender_session, int sender_id,
+                            const FileRecord* file) {
     try {
-        std::cout << "DEBUG: deliverMessage called - sender_id: " << sender_id << ", receiver: " << receiver_username << std::endl;
-        
+        std::string receiver_username(message.to);
+
         // Получаем информацию о получателе
         auto receiver_user = user_manager_.getUser(receiver_username);
         if (receiver_user == nullptr) {
-            std::cout << "Receiver " << receiver_username << " not found!" << std::endl;
+            LOG_INFO("message dropped, receiver not found", "sender_id", sender_id, "to", receiver_username);
             return;
         }
         
         int receiver_id = receiver_user->id;
-        std::string content = message["content"];
-        
-        std::cout << "DEBUG: Message content: " << content << std::endl;
-        
-        // Проверяем, онлайн ли получатель
-        auto receiver_session = user_manager_.getSession(receiver_id);
+        std::string content(message.content);
+        std::int64_t sent_at = messageTimestampNow();
+        bool is_file = file != nullptr;
+        std::string file_path = is_file ? file->id : std::string(); // Путь внутри каталога blob'ов
         
-        std::cout << "DEBUG: Receiver session " << (receiver_session != nullptr ? "FOUND" : "NOT FOUND") << std::endl;
-        
-        if (receiver_session != nullptr) {
-            // Пользователь онлайн - сохраняем сообщение как доставленное
-            bool stored = db_.storeMessage(sender_id, receiver_id, content, true); // is_delivered = true
-            if (!stored) {
-                std::cerr << "Failed to store message in database" << std::endl;
-                return;
+        // Проверяем, онлайн ли получатель. Проверка и постановка оффлайн-строки в очередь
+        // идут под streams_mutex_, и выдача после входа (sendStoredMessages) их дожидается. Иначе строка,
+        // попавшая в очередь после коммита, которого ждет выдача, осталась бы до следующего входа
+        std::shared_ptr<Session> receiver_session;
+        {
+            std::lock_guard<std::mutex> lock(streams_mutex_);
+            receiver_session = user_manager_.getSession(receiver_id);
+            if (receiver_session == nullptr) {
+                // Пользователь оффлайн - сохраняем сообщение как недоставленное
+                storeInStreamLocked(NewMessage{sender_id, receiver_id, std::move(content), sent_at, 0,
+                                               false, // is_delivered = false
+                                               is_file, std::move(file_path)});
             }
+        }
+
+        if (receiver_session != nullptr) {
+            // Пользователь онлайн - сохраняем сообщение в фоне, не дожидаясь диска. Клиент
+            // с ack'ами подтвердит доставку сам, до тех пор строка считается недоставленной
+            bool acked_by_client = receiver_session->deliveryAcks();
+            std::int64_t seq = storeInStream(NewMessage{sender_id, receiver_id, content, sent_at, 0, !acked_by_client,
+                                                        is_file, file_path});
             
             // Отправляем сообщение сразу
-            json delivery_message = message;
-            delivery_message["timestamp"] = std::time(nullptr);
+            json delivery_message;
+            delivery_message["type"] = commandName(Command::Message);
+            delivery_message["to"] = receiver_username;
+            delivery_message["content"] = content;
+            delivery_message["timestamp"] = sent_at / 1000;
+            delivery_message["sent_at"] = sent_at;
+            delivery_message["seq"] = seq;
             delivery_message["delivered"] = true;
+            if (is_file) {
+                delivery_message["is_file"] = true;
+                delivery_message["file_id"] = file->id;
+                delivery_message["file_size"] = file->size;
+            }
             
             // Добавляем информацию об отправителе
             auto sender_user = user_manager_.getUserById(sender_id);
@@ -85,26 +167,28 @@ void Router::deliverMessage(const json& message, int sender_id, const std::strin
                 delivery_message["from"] = sender_user->username;
             }
             
-            receiver_session->send(delivery_message);
-            std::cout << "Message delivered to " << receiver_username << " (online)" << std::endl;
-        } else {
-            // Пользователь оффлайн - сохраняем сообщение как недоставленное
-            bool stored = db_.storeMessage(sender_id, receiver_id, content, false); // is_delivered = false
-            if (!stored) {
-                std::cerr << "Failed to store offline message in database" << std::endl;
-                return;
+            // У пользователя одна сессия (UserManager) - фрейм строит сама сессия
+            receiver_session->send(std::move(delivery_message));
+            LOG_DEBUG("message delivered", "sender_id", sender_id, "to", receiver_username);
+
+            // Получатель не успевает читать - притормаживаем отправителя
+            if (receiver_session->isCongested() &&
+                receiver_session->slowConsumerPolicy() == SlowConsumerPolicy::PauseSender) {
+                LOG_DEBUG("receiver congested, pausing sender", "sender_id", sender_id, "to", receiver_username);
+                receiver_session->pauseSenderUntilDrained(sender_session);
             }
-            std::cout << "Message stored for offline user: " << receiver_username << std::endl;
+        } else {
+            LOG_DEBUG("message stored for offline user", "sender_id", sender_id, "to", receiver_username);
         }
         
     } catch (const std::exception& e) {
-        std::cerr << "Error delivering message: " << e.what() << std::endl;
+        LOG_ERROR("error delivering message", "error", e.what());
     }
 }
 
 // void Router::storeOfflineMessage(const json& message, int sender_id, int receiver_id) {
 //     try {
-//         std::string content = message["content"];
+//         std::string content(message.content);
 //         bool stored = db_.storeMessage(sender_id, receiver_id, content);
         
 //         if (stored) {
@@ -117,47 +201,377 @@ void Router::deliverMessage(const json& message, int sender_id, const std::strin
 //     }
 // }
 
+void Router::afterQueuedWrites(const std::shared_ptr<Session>& session, std::function<void()> callback) {
+    // Колбэк писателя выполняется на его потоке - только передаем работу сессии
+    std::weak_ptr<Session> weak_session = session;
+    message_writer_.whenCommitted([weak_session, callback = std::move(callback)](bool committed) mutable {
+        auto session = weak_session.lock();
+        if (!session) {
+            return;
+        }
+        if (!committed) {
+            LOG_WARN("continuing after a dropped message batch", "user_id", session->getUserId());
+        }
+        session->post(std::move(callback));
+    });
+}
+
 void Router::sendStoredMessages(int user_id, std::shared_ptr<Session> session) {
+    {
+        // Сессия уже добавлена: отправитель, увидевший пользователя оффлайн, к этому моменту
+        // поставил строку в очередь, а следующие увидят его онлайн (см. deliverMessage)
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+    }
+    // Недоставленные сообщения могут еще стоять в очереди на запись
+    std::weak_ptr<Session> weak_session = session;
+    afterQueuedWrites(session, [this, user_id, weak_session]() {
+        if (auto session = weak_session.lock()) {
+            sendStoredPage(user_id, session, 0, 0);
+        }
+    });
+}
+
+void Router::sendStoredPage(int user_id, const std::shared_ptr<Session>& session, std::int64_t after_id, std::size_t sent) {
     try {
-        std::cout << "DEBUG: Checking offline messages for user ID: " << user_id << std::endl;
-        
-        // Получаем все оффлайн-сообщения для пользователя
-        std::vector<Message> offline_messages = db_.getOfflineMessages(user_id);
-        
-        std::cout << "DEBUG: Found " << offline_messages.size() << " offline messages" << std::endl;
-        
-        if (!offline_messages.empty()) {
-            std::cout << "Sending " << offline_messages.size() << " stored messages to user ID: " << user_id << std::endl;
-            
-            for (const auto& msg : offline_messages) {
-                // Получаем информацию об отправителе
+        std::vector<Message> page;
+        page.reserve(kOfflinePageSize);
+        if (!db_.readOfflineMessages(user_id, after_id, kOfflinePageSize, page)) {
+            LOG_ERROR("offline delivery stopped", "user_id", user_id, "sent", sent);
+            return;
+        }
+        if (page.empty()) {
+            if (sent > 0) {
+                LOG_INFO("stored messages sent", "user_id", user_id, "count", sent);
+            }
+            return;
+        }
+
+        std::unordered_map<int, std::string> sender_names; // Отправителей в странице обычно немного
+        for (const auto& msg : page) {
+            auto name = sender_names.find(msg.sender_id);
+            if (name == sender_names.end()) {
                 auto sender_user = user_manager_.getUserById(msg.sender_id);
-                
-                json stored_message;
-                stored_message["type"] = "message";
-                stored_message["from"] = sender_user ? sender_user->username : "unknown";
-                stored_message["content"] = msg.content;
-                stored_message["timestamp"] = std::time(nullptr); // Используем текущее время для совместимости
-                stored_message["original_time"] = msg.sent_at; // Оригинальное время как строка
-                stored_message["stored"] = true;
-                
-                if (msg.is_file) {
-                    stored_message["is_file"] = true;
-                    stored_message["file_path"] = msg.file_path;
-                }
-                
-                session->send(stored_message);
+                name = sender_names.emplace(msg.sender_id, sender_user ? sender_user->username : "unknown").first;
             }
+
+            json stored_message;
+            stored_message["type"] = commandName(Command::Message);
+            stored_message["from"] = name->second;
+            stored_message["content"] = msg.content;
+            stored_message["timestamp"] = msg.sent_at / 1000; // Время отправки, а не доставки
+            stored_message["sent_at"] = msg.sent_at;
+            stored_message["seq"] = msg.seq;
+            stored_message["stored"] = true;
             
-            // Удаляем доставленные сообщения
-            db_.deleteOfflineMessages(user_id);
+            if (msg.is_file) {
+                stored_message["is_file"] = true;
+                stored_message["file_path"] = msg.file_path;
+                stored_message["file_id"] = msg.file_path; // Blob хранится под id файла
+            }
+            
+            session->send(stored_message);
+        }
+        sent += page.size();
+
+        // Страница помечается доставленной, только когда ее байты ушли в сокет:
+        // при обрыве посреди выдачи она придет снова при следующем входе.
+        // Клиенту с ack'ами строки остаются недоставленными до подтверждения.
+        // Следующая страница читается тоже после записи - очередь сессии не растет,
+        // сколько бы сообщений ни накопилось
+        std::weak_ptr<Session> weak_session = session;
+        std::int64_t cursor = page.back().id;
+        bool last_page = page.size() < kOfflinePageSize;
+        std::vector<int> sender_ids;
+        sender_ids.reserve(sender_names.size());
+        for (const auto& [sender_id, name] : sender_names) {
+            sender_ids.push_back(sender_id);
         }
+        session->whenWritten([this, user_id, weak_session, after_id, cursor, sent, last_page,
+                              sender_ids = std::move(sender_ids)]() {
+            auto session = weak_session.lock();
+            if (!session) {
+                return;
+            }
+            if (!session->deliveryAcks() && !db_.markOfflineDelivered(user_id, after_id, cursor, sender_ids)) {
+                LOG_ERROR("offline delivery stopped", "user_id", user_id, "sent", sent);
+                return;
+            }
+            if (last_page) {
+                LOG_INFO("stored messages sent", "user_id", user_id, "count", sent);
+                return;
+            }
+            sendStoredPage(user_id, session, cursor, sent);
+        });
     } catch (const std::exception& e) {
-        std::cerr << "Error sending stored messages: " << e.what() << std::endl;
+        LOG_ERROR("error sending stored messages", "user_id", user_id, "error", e.what());
     }
 }
 
-void Router::routeFileTransfer(const json& message, std::shared_ptr<Session> sender_session) {
-    // Placeholder for future file transfer implementation
-    std::cout << "File transfer not yet implemented" << std::endl;
+std::int64_t& Router::streamSequenceLocked(int sender_id, int receiver_id) {
+    std::uint64_t key = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(sender_id)) << 32) |
+                        static_cast<std::uint32_t>(receiver_id);
+    auto it = stream_sequences_.find(key);
+    if (it == stream_sequences_.end()) {
+        // Неизвестный поток: в очереди записи его строк нет, БД знает последний seq
+        it = stream_sequences_.emplace(key, StreamSequence{db_.lastSequence(sender_id, receiver_id), 0}).first;
+        if (stream_sequences_.size() >= stream_eviction_at_) {
+            scheduleStreamEvictionLocked();
+        }
+    }
+    it->second.epoch = stream_epoch_;
+    return it->second.last_seq;
+}
+
+void Router::scheduleStreamEvictionLocked() {
+    if (stream_eviction_scheduled_) {
+        return;
+    }
+    stream_eviction_scheduled_ = true;
+    timing_wheel_.schedule(stream_eviction_timer_, kStreamEvictionDelay, [this]() { evictIdleStreams(); });
+}
+
+void Router::evictIdleStreams() {
+    // Потоки, не тронутые с прошлого вытеснения, получили последнюю строку раньше этой
+    // точки. Забывать их можно только после ее коммита: иначе seq из БД отстал бы от выданных
+    std::uint64_t epoch;
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        epoch = ++stream_epoch_;
+    }
+    message_writer_.whenCommitted([this, epoch](bool committed) {
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        stream_eviction_scheduled_ = false;
+        if (!committed) {
+            return; // Строки потеряны: БД не знает выданных seq, держим их в памяти
+        }
+        std::size_t before = stream_sequences_.size();
+        for (auto it = stream_sequences_.begin(); it != stream_sequences_.end();) {
+            if (it->second.epoch < epoch) {
+                it = stream_sequences_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        stream_eviction_at_ = std::max(kMinStreamsToEvict, 2 * stream_sequences_.size());
+        LOG_DEBUG("idle streams evicted", "count", before - stream_sequences_.size(),
+                  "remaining", stream_sequences_.size());
+    });
+}
+
+std::int64_t Router::storeInStream(NewMessage message) {
+    std::lock_guard<std::mutex> lock(streams_mutex_);
+    return storeInStreamLocked(std::move(message));
+}
+
+std::int64_t Router::storeInStreamLocked(NewMessage message) {
+    std::int64_t& last_seq = streamSequenceLocked(message.sender_id, message.receiver_id);
+    message.seq = ++last_seq;
+    std::int64_t seq = message.seq;
+    message_writer_.enqueue(std::move(message));
+    return seq;
+}
+
+void Router::acknowledge(int receiver_id, std::string_view from_username, std::uint64_t seq) {
+    try {
+        auto sender_user = user_manager_.getUser(std::string(from_username));
+        if (sender_user == nullptr) {
+            LOG_DEBUG("ack for unknown sender ignored", "receiver_id", receiver_id, "from", from_username);
+            return;
+        }
+
+        // Нельзя подтвердить то, что еще не отправлено
+        std::int64_t acked;
+        {
+            std::lock_guard<std::mutex> lock(streams_mutex_);
+            std::int64_t last_seq = streamSequenceLocked(sender_user->id, receiver_id);
+            acked = seq > static_cast<std::uint64_t>(last_seq) ? last_seq : static_cast<std::int64_t>(seq);
+        }
+        if (acked > 0) {
+            message_writer_.enqueueAck(DeliveryAck{receiver_id, sender_user->id, acked});
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("error applying ack", "receiver_id", receiver_id, "error", e.what());
+    }
+}
+
+std::vector<AckWatermark> Router::ackWatermarks(int receiver_id) {
+    return db_.getAckWatermarks(receiver_id);
+}
+
+bool Router::beginUpload(int sender_id, std::string_view to_username, std::string name, std::uint64_t size,
+                         FileRecord& file, std::string& error) {
+    try {
+        if (size == 0 || size > file_store_.settings().max_file_size) {
+            error = "File size must be between 1 and " + std::to_string(file_store_.settings().max_file_size) + " bytes";
+            return false;
+        }
+        auto receiver_user = user_manager_.getUser(std::string(to_username));
+        if (receiver_user == nullptr) {
+            error = "Receiver not found";
+            return false;
+        }
+        switch (file_store_.createUpload(sender_id, receiver_user->id, std::move(name), size, file)) {
+            case FileStore::CreateResult::Created:
+                return true;
+            case FileStore::CreateResult::TooManyUploads:
+                error = "Too many unfinished uploads";
+                return false;
+            case FileStore::CreateResult::QuotaExceeded:
+                error = "Upload quota exceeded";
+                return false;
+            case FileStore::CreateResult::Failed:
+                break;
+        }
+        error = "Cannot start upload";
+        return false;
+    } catch (const std::exception& e) {
+        LOG_ERROR("error starting upload", "sender_id", sender_id, "error", e.what());
+        error = "Upload error";
+        return false;
+    }
+}
+
+bool Router::resumeUpload(int sender_id, const std::string& file_id, FileRecord& file, std::uint64_t& received,
+                          std::string& error) {
+    auto stored = file_store_.find(file_id);
+    if (stored == nullptr || stored->sender_id != sender_id) {
+        error = "Unknown upload";
+        return false;
+    }
+    file = std::move(*stored);
+    received = file_store_.receivedBytes(file);
+    LOG_INFO("upload resumed", "file_id", file.id, "offset", received, "size", file.size);
+    return true;
+}
+
+FileStore::ChunkResult Router::receiveFileChunk(std::shared_ptr<Session> sender_session, const std::string& file_id,
+                                                std::uint64_t offset, std::string_view data, std::uint64_t& received) {
+    try {
+        auto file = file_store_.find(file_id);
+        if (file == nullptr || file->sender_id != sender_session->getUserId()) {
+            return FileStore::ChunkResult::UnknownFile;
+        }
+
+        auto result = file_store_.appendChunk(*file, offset, data, received);
+        if (result == FileStore::ChunkResult::Completed) {
+            routeFileTransfer(*file, sender_session);
+        }
+        return result;
+    } catch (const std::exception& e) {
+        LOG_ERROR("error receiving file chunk", "file_id", file_id, "error", e.what());
+        return FileStore::ChunkResult::Failed;
+    }
+}
+
+void Router::routeFileTransfer(const FileRecord& file, std::shared_ptr<Session> sender_session) {
+    try {
+        auto receiver_user = user_manager_.getUserById(file.receiver_id);
+        if (receiver_user == nullptr) {
+            LOG_WARN("file receiver disappeared", "file_id", file.id, "receiver_id", file.receiver_id);
+            return;
+        }
+
+        // Файл приходит получателю обычным сообщением: с seq, ack'ами и оффлайн-доставкой
+        deliverMessage(ChatMessageRequest{receiver_user->username, file.name, std::nullopt},
+                       sender_session, file.sender_id, &file);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error routing file", "file_id", file.id, "error", e.what());
+    }
+}
+
+std::shared_ptr<const BlobFile> Router::openDownload(int user_id, const std::string& file_id, FileRecord& file,
+                                                     std::string& error) {
+    auto stored = file_store_.find(file_id);
+    if (stored == nullptr || (stored->sender_id != user_id && stored->receiver_id != user_id)) {
+        error = "File not found";
+        return nullptr;
+    }
+    if (!stored->complete) {
+        error = "File upload is not finished";
+        return nullptr;
+    }
+
+    auto blob = file_store_.openBlob(*stored);
+    if (blob == nullptr) {
+        LOG_ERROR("blob missing", "file_id", file_id);
+        error = "File not available";
+        return nullptr;
+    }
+    file = std::move(*stored);
+    return blob;
+}
+
+void Router::sendFile(std::shared_ptr<Session> session, FileRecord file, std::shared_ptr<const BlobFile> blob,
+                      std::uint64_t offset) {
+    LOG_INFO("file download started", "file_id", file.id, "user", session->getUsername(), "offset", offset);
+    auto download = std::make_shared<const FileDownload>(FileDownload{std::move(file), std::move(blob)});
+    sendFileChunk(session, std::move(download), offset);
+}
+
+void Router::sendFileChunk(const std::shared_ptr<Session>& session, std::shared_ptr<const FileDownload> download,
+                           std::uint64_t offset) {
+    try {
+        const FileRecord& file = download->file;
+        offset = std::min(offset, file.size);
+        auto length = static_cast<std::size_t>(
+            std::min<std::uint64_t>(file_store_.settings().chunk_size, file.size - offset));
+        bool last = offset + length == file.size;
+
+        json header;
+        header["type"] = commandName(Command::FileData);
+        header["file_id"] = file.id;
+        header["offset"] = offset;
+        header["length"] = length;
+        header["last"] = last;
+
+        if (session->getFramingMode() == FramingMode::LengthPrefixed) {
+            // Байты идут следующим сырым фреймом, из page cache прямо в сокет
+            session->sendFileChunk(OutboundFrame::fromJson(std::move(header)), FileSlice{download->blob, offset, length});
+            continueDownload(session, std::move(download), offset + length);
+            return;
+        }
+
+        // В newline-фрейминге сырой фрейм не передать - байты едут в base64.
+        // Чтение с диска и кодирование не занимают io-поток
+        std::weak_ptr<Session> weak_session = session;
+        boost::asio::post(file_reads_, [this, weak_session, download, offset, length, header = std::move(header)]() mutable {
+            auto session = weak_session.lock();
+            if (!session) {
+                return;
+            }
+            try {
+                std::string data;
+                if (!download->blob->read(offset, length, data)) {
+                    LOG_ERROR("failed to read blob", "file_id", download->file.id, "offset", offset);
+                    return;
+                }
+                header["data"] = base64Encode(data);
+                session->sendFileChunk(OutboundFrame::fromJson(std::move(header)));
+                continueDownload(session, download, offset + length);
+            } catch (const std::exception& e) {
+                LOG_ERROR("error sending file chunk", "file_id", download->file.id, "error", e.what());
+            }
+        });
+    } catch (const std::exception& e) {
+        LOG_ERROR("error sending file chunk", "file_id", download->file.id, "error", e.what());
+    }
+}
+
+void Router::continueDownload(const std::shared_ptr<Session>& session, std::shared_ptr<const FileDownload> download,
+                              std::uint64_t next) {
+    if (next >= download->file.size) {
+        LOG_INFO("file download queued", "file_id", download->file.id, "user", session->getUsername(),
+                 "size", download->file.size);
+        return;
+    }
+
+    // Следующий чанк - когда клиент прочитает очередь: загрузка не раздувает
+    // буферы, а чат-фреймы обгоняют чанки в очереди сессии. Регистрация идет
+    // в strand сессии после постановки чанка, так что его байты уже учтены
+    std::weak_ptr<Session> weak_session = session;
+    session->whenDrained([this, weak_session, download = std::move(download), next]() {
+        if (auto session = weak_session.lock()) {
+            sendFileChunk(session, download, next);
+        }
+    });
 }
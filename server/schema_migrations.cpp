@@ -0,0 +1,230 @@
+#include "include/schema_migrations.h"
+#include "include/logger.h"
+#include <stdexcept>
+#include <string>
+
+namespace {
+void exec(sqlite3* db, const char* sql, const std::string& context) {
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK) {
+        std::string error = "SQL error on " + context + ": ";
+        error += err_msg ? err_msg : sqlite3_errmsg(db);
+        sqlite3_free(err_msg);
+        throw std::runtime_error(error);
+    }
+}
+
+int currentVersion(sqlite3* db) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT COALESCE(MAX(version), 0) FROM schema_version;", -1, &stmt, NULL) != SQLITE_OK) {
+        throw std::runtime_error(std::string("Can't read schema version: ") + sqlite3_errmsg(db));
+    }
+    int version = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+void recordVersion(sqlite3* db, const Migration& migration) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "INSERT INTO schema_version (version, description) VALUES (?, ?);", -1, &stmt, NULL) != SQLITE_OK) {
+        throw std::runtime_error(std::string("Can't record schema version: ") + sqlite3_errmsg(db));
+    }
+    sqlite3_bind_int(stmt, 1, migration.version);
+    sqlite3_bind_text(stmt, 2, migration.description, -1, SQLITE_STATIC);
+    int result = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (result != SQLITE_DONE) {
+        throw std::runtime_error(std::string("Can't record schema version: ") + sqlite3_errmsg(db));
+    }
+}
+
+bool hasColumn(sqlite3* db, const char* table, const char* column) {
+    sqlite3_stmt* stmt;
+    std::string sql = std::string("PRAGMA table_info(") + table + ");";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK) {
+        throw std::runtime_error(std::string("Can't inspect table ") + table + ": " + sqlite3_errmsg(db));
+    }
+    bool found = false;
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        found = name != nullptr && std::string(name) == column;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Самые старые базы (как messenger.db в репозитории) содержат users без email.
+// Таблица пересоздается по схеме migration 1 с сохранением id - на них ссылаются
+// сообщения; вместо email - уникальная заглушка, пользователь может ее сменить
+void convertLegacyUsers(sqlite3* db) {
+    if (!hasColumn(db, "users", "id") || hasColumn(db, "users", "email")) {
+        return;
+    }
+    // users_new переименовывается в users: внешние ключи messages продолжают указывать на users
+    exec(db,
+         "CREATE TABLE users_new ("
+         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+         "username TEXT NOT NULL UNIQUE,"
+         "email TEXT NOT NULL UNIQUE,"
+         "password_hash TEXT NOT NULL,"
+         "created_at DATETIME DEFAULT CURRENT_TIMESTAMP);"
+         "INSERT INTO users_new (id, username, email, password_hash) "
+         "SELECT id, username, username || '@legacy.invalid', password_hash FROM users;"
+         "DROP TABLE users;"
+         "ALTER TABLE users_new RENAME TO users;",
+         "legacy users table");
+    LOG_WARN("legacy users table without email converted, emails set to <username>@legacy.invalid",
+             "users", sqlite3_changes(db));
+}
+}
+
+const std::vector<Migration>& schemaMigrations() {
+    static const std::vector<Migration> migrations = {
+        {1, "users and messages tables",
+         // IF NOT EXISTS: базы, созданные до появления миграций, уже содержат эти таблицы
+         "CREATE TABLE IF NOT EXISTS users ("
+         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+         "username TEXT NOT NULL UNIQUE,"
+         "email TEXT NOT NULL UNIQUE,"
+         "password_hash TEXT NOT NULL,"
+         "created_at DATETIME DEFAULT CURRENT_TIMESTAMP);"
+         "CREATE TABLE IF NOT EXISTS messages ("
+         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+         "sender_id INTEGER NOT NULL,"
+         "receiver_id INTEGER NOT NULL,"
+         "content TEXT NOT NULL,"
+         "sent_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
+         "is_file BOOLEAN DEFAULT FALSE,"
+         "file_path TEXT,"
+         "is_delivered BOOLEAN DEFAULT FALSE,"
+         "FOREIGN KEY(sender_id) REFERENCES users(id),"
+         "FOREIGN KEY(receiver_id) REFERENCES users(id));",
+         convertLegacyUsers},
+
+        {2, "indexes for offline drain and conversation history",
+         // getOfflineMessages: WHERE receiver_id = ? AND is_delivered = 0 ORDER BY sent_at
+         "CREATE INDEX IF NOT EXISTS idx_messages_receiver_delivered "
+         "ON messages (receiver_id, is_delivered, sent_at);"
+         // getMessages: каждая ветка OR - поиск по паре (sender_id, receiver_id), уже упорядоченный по sent_at
+         "CREATE INDEX IF NOT EXISTS idx_messages_conversation "
+         "ON messages (sender_id, receiver_id, sent_at);"},
+
+        {3, "integer millisecond sent_at",
+         // Текстовый DATETIME с точностью до секунды -> INTEGER миллисекунды (Unix epoch).
+         // SQLite не меняет тип столбца, поэтому таблица пересоздается; индексы тоже,
+         // порядок внутри одной миллисекунды дает id (rowid входит в каждый индекс)
+         "CREATE TABLE messages_new ("
+         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+         "sender_id INTEGER NOT NULL,"
+         "receiver_id INTEGER NOT NULL,"
+         "content TEXT NOT NULL,"
+         "sent_at INTEGER NOT NULL,"
+         "is_file BOOLEAN DEFAULT FALSE,"
+         "file_path TEXT,"
+         "is_delivered BOOLEAN DEFAULT FALSE,"
+         "FOREIGN KEY(sender_id) REFERENCES users(id),"
+         "FOREIGN KEY(receiver_id) REFERENCES users(id));"
+         "INSERT INTO messages_new (id, sender_id, receiver_id, content, sent_at, is_file, file_path, is_delivered) "
+         "SELECT id, sender_id, receiver_id, content, COALESCE(CAST(strftime('%s', sent_at) AS INTEGER) * 1000, 0), "
+         "is_file, file_path, is_delivered FROM messages;"
+         "DROP TABLE messages;"
+         "ALTER TABLE messages_new RENAME TO messages;"
+         "CREATE INDEX idx_messages_receiver_delivered ON messages (receiver_id, is_delivered, sent_at);"
+         "CREATE INDEX idx_messages_conversation ON messages (sender_id, receiver_id, sent_at);"},
+
+        {4, "partial index of undelivered messages",
+         // Оффлайн-доставка идет страницами по id; доставленные строки выпадают из индекса,
+         // так что он хранит только очередь
+         "DROP INDEX IF EXISTS idx_messages_receiver_delivered;"
+         "CREATE INDEX idx_messages_undelivered ON messages (receiver_id) WHERE is_delivered = 0;"},
+
+        {5, "per-stream sequence numbers and delivery acks",
+         // seq нумерует сообщения потока sender -> receiver; старые строки нумеруем по id.
+         // Уникальный индекс по потоку заменяет idx_messages_conversation: историю переписки
+         // сервер не читает, а lastSequence ищет по той же паре (sender_id, receiver_id)
+         "ALTER TABLE messages ADD COLUMN seq INTEGER NOT NULL DEFAULT 0;"
+         "UPDATE messages SET seq = numbered.rn FROM ("
+         "SELECT id, ROW_NUMBER() OVER (PARTITION BY sender_id, receiver_id ORDER BY id) AS rn FROM messages"
+         ") AS numbered WHERE messages.id = numbered.id;"
+         "DROP INDEX IF EXISTS idx_messages_conversation;"
+         "CREATE UNIQUE INDEX idx_messages_stream ON messages (sender_id, receiver_id, seq);"
+         "CREATE TABLE delivery_acks ("
+         "receiver_id INTEGER NOT NULL,"
+         "sender_id INTEGER NOT NULL,"
+         "acked_seq INTEGER NOT NULL,"
+         "PRIMARY KEY (receiver_id, sender_id)) WITHOUT ROWID;"
+         // Водяной знак - до первого недоставленного сообщения потока
+         "INSERT INTO delivery_acks (receiver_id, sender_id, acked_seq) "
+         "SELECT receiver_id, sender_id, COALESCE(MIN(CASE WHEN is_delivered = 0 THEN seq END) - 1, MAX(seq)) "
+         "FROM messages GROUP BY receiver_id, sender_id;"},
+        {6, "files table for chunked uploads",
+         // Загрузка незавершена, пока completed_at IS NULL; ее байты лежат в <id>.part
+         "CREATE TABLE files ("
+         "id TEXT PRIMARY KEY,"
+         "sender_id INTEGER NOT NULL,"
+         "receiver_id INTEGER NOT NULL,"
+         "name TEXT NOT NULL,"
+         "size INTEGER NOT NULL,"
+         "created_at INTEGER NOT NULL,"
+         "completed_at INTEGER,"
+         "FOREIGN KEY (sender_id) REFERENCES users (id),"
+         "FOREIGN KEY (receiver_id) REFERENCES users (id)) WITHOUT ROWID;"},
+
+        {7, "resync delivery ack watermarks",
+         // Строки, доставленные клиентам без ack'ов, не двигали водяной знак -
+         // поднимаем его до первого недоставленного сообщения потока
+         "INSERT INTO delivery_acks (receiver_id, sender_id, acked_seq) "
+         "SELECT receiver_id, sender_id, COALESCE(MIN(CASE WHEN is_delivered = 0 THEN seq END) - 1, MAX(seq)) "
+         "FROM messages WHERE true GROUP BY receiver_id, sender_id "
+         "ON CONFLICT (receiver_id, sender_id) DO UPDATE SET acked_seq = MAX(acked_seq, excluded.acked_seq);"},
+
+        {8, "index of unfinished uploads",
+         // Квота отправителя и чистка брошенных загрузок смотрят только на незавершенные
+         "CREATE INDEX idx_files_unfinished ON files (sender_id) WHERE completed_at IS NULL;"},
+    };
+    return migrations;
+}
+
+int applyMigrations(sqlite3* db) {
+    exec(db,
+         "CREATE TABLE IF NOT EXISTS schema_version ("
+         "version INTEGER PRIMARY KEY,"
+         "description TEXT NOT NULL,"
+         "applied_at DATETIME DEFAULT CURRENT_TIMESTAMP);",
+         "schema_version table creation");
+
+    int version = currentVersion(db);
+    const auto& migrations = schemaMigrations();
+    int latest = migrations.empty() ? 0 : migrations.back().version;
+    if (version > latest) {
+        throw std::runtime_error("Database schema version " + std::to_string(version) +
+                                 " is newer than this server supports (" + std::to_string(latest) + ")");
+    }
+
+    for (const auto& migration : migrations) {
+        if (migration.version <= version) {
+            continue;
+        }
+
+        // Миграция и запись о ней - одна транзакция: либо применена целиком, либо нет
+        exec(db, "BEGIN IMMEDIATE;", "migration begin");
+        try {
+            if (migration.prepare != nullptr) {
+                migration.prepare(db);
+            }
+            exec(db, migration.sql, "migration " + std::to_string(migration.version));
+            recordVersion(db, migration);
+            exec(db, "COMMIT;", "migration commit");
+        } catch (...) {
+            sqlite3_exec(db, "ROLLBACK;", 0, 0, nullptr);
+            throw;
+        }
+
+        version = migration.version;
+        LOG_INFO("schema migration applied", "version", migration.version, "description", migration.description);
+    }
+    return version;
+}
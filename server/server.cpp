@@ -2,55 +2,154 @@
 // Server -> Session -> JsonParser -> UserManager/Router -> Database
 
 #include <iostream>
+#include <algorithm>
+#include <cctype>
 #include <boost/asio.hpp>
 #include <memory>
+#include <mutex>
 #include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include "include/common.hpp"
 #include "include/database.h"
+#include "include/message_writer.h"
+#include "include/file_store.h"
+#include "include/presence_manager.h"
 #include "include/user_manager.h"
 #include "include/router.h"
 #include "include/json_parser.h"
 #include "include/session.h"
+#include "include/server_config.h"
+#include "include/timing_wheel.h"
+#include "include/logger.h"
 
 using boost::asio::ip::tcp;
 using json = nlohmann::json;
 
+// Реактор, который выбрал Boost.Asio для этой платформы
+#if defined(BOOST_ASIO_HAS_EPOLL)
+constexpr const char* kIoBackend = "epoll";
+#else
+constexpr const char* kIoBackend = "default reactor";
+#endif
+
 class Server {
 public:
-    Server(boost::asio::io_context& io_context, short port)
-        : acceptor_(io_context, tcp::endpoint(tcp::v4(), port)),
-          db_("messenger.db"),
-          user_manager_(db_),
-          router_(db_, user_manager_),
+    Server(boost::asio::io_context& io_context, const ServerConfig& config)
+        : io_context_(io_context),
+          config_(config),
+          timing_wheel_(io_context, config.timeouts.wheel_tick),
+          acceptor_(io_context, tcp::endpoint(tcp::v4(), config.port)),
+          db_(config.db_path, config.database),
+          message_writer_(db_, config.persistence),
+          file_store_(db_, timing_wheel_, config.files, config.max_frame_size),
+          presence_(timing_wheel_, config.presence),
+          user_manager_(db_, presence_),
+          router_(db_, user_manager_, message_writer_, file_store_, timing_wheel_, config.typing),
           json_parser_(std::make_shared<JsonParser>(user_manager_, router_)) {
         
-        std::cout << "Server components initialized successfully" << std::endl;
+        timing_wheel_.start();
+        message_writer_.start();
+        LOG_INFO("server components initialized");
         do_accept();
     }
 
+    // The writer runs its leftover commit callbacks (router, sessions) while they still exist
+    ~Server() {
+        message_writer_.stop();
+    }
+
+    // Stops accepting, closes every session and stops the timing wheel. io_context.run()
+    // returns once the session coroutines have finished, so no session outlives the members
+    // it references (timing wheel, router, database) when Server is destroyed
+    void stop() {
+        boost::asio::post(io_context_, [this]() {
+            std::vector<std::shared_ptr<Session>> sessions;
+            {
+                std::lock_guard<std::mutex> lock(sessions_mutex_);
+                stopping_ = true;
+                for (auto& weak_session : sessions_) {
+                    if (auto session = weak_session.lock()) {
+                        sessions.push_back(std::move(session));
+                    }
+                }
+                sessions_.clear();
+            }
+            boost::system::error_code ec;
+            acceptor_.close(ec);
+            LOG_INFO("closing sessions", "sessions", sessions.size());
+            for (auto& session : sessions) {
+                session->close();
+            }
+            timing_wheel_.stop();
+        });
+    }
+
 private:
     void do_accept() {
-        acceptor_.async_accept(
+        // Каждая сессия получает свой strand: обработчики одной сессии
+        // никогда не выполняются параллельно, разные сессии - на разных потоках
+        acceptor_.async_accept(boost::asio::make_strand(io_context_),
             [this](boost::system::error_code ec, tcp::socket socket) {
+                if (ec == boost::asio::error::operation_aborted) {
+                    return; // Акцептор закрыт в stop()
+                }
                 if (!ec) {
-                    std::cout << "New client connected from: " << socket.remote_endpoint() << std::endl;
+                    boost::system::error_code endpoint_ec;
+                    auto remote = socket.remote_endpoint(endpoint_ec);
+                    LOG_INFO("client connected", "address", remote.address().to_string(), "port", remote.port());
                     
                     // Создаем новую сессию с общим JsonParser
-                    std::make_shared<Session>(std::move(socket), json_parser_)->start();
+                    auto session = std::make_shared<Session>(std::move(socket), json_parser_, timing_wheel_, config_);
+                    if (!trackSession(session)) {
+                        return; // Сервер останавливается, сокет закроется вместе с сессией
+                    }
+                    session->start();
                 } else {
-                    std::cerr << "Accept error: " << ec.message() << std::endl;
+                    LOG_WARN("accept error", "error", ec.message());
                 }
                 
                 do_accept();
             });
     }
 
+    // Remembers the session for stop(); false once the server is stopping
+    bool trackSession(const std::shared_ptr<Session>& session) {
+        std::lock_guard<std::mutex> lock(sessions_mutex_);
+        if (stopping_) {
+            return false;
+        }
+        // Закрытые сессии вычищаем, когда их набирается столько же, сколько живых
+        if (sessions_.size() >= 2 * live_sessions_hint_ + kMinSessionsToPrune) {
+            sessions_.erase(std::remove_if(sessions_.begin(), sessions_.end(),
+                                           [](const std::weak_ptr<Session>& weak) { return weak.expired(); }),
+                            sessions_.end());
+            live_sessions_hint_ = sessions_.size();
+        }
+        sessions_.push_back(session);
+        return true;
+    }
+
+    static constexpr std::size_t kMinSessionsToPrune = 64;
+
+    boost::asio::io_context& io_context_;
+    ServerConfig config_;
+    TimingWheel timing_wheel_;
     tcp::acceptor acceptor_;
     Database db_;
+    MessageWriter message_writer_; // Declared after db_: stopped (and drained) before the database closes
+    FileStore file_store_;
+    PresenceManager presence_;
     UserManager user_manager_;
     Router router_;
     std::shared_ptr<JsonParser> json_parser_;
+
+    std::mutex sessions_mutex_;
+    std::vector<std::weak_ptr<Session>> sessions_; // Every accepted session, including unauthenticated ones
+    std::size_t live_sessions_hint_ = 0;
+    bool stopping_ = false;
 };
 
 // static void ShowJsonExamples()
@@ -85,29 +184,153 @@ private:
 //         std::cout << "================================\n" << std::endl;
 // }
 
+static bool parseArguments(int argc, char* argv[], ServerConfig& config) {
+    bool port_set = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--io-threads=", 0) == 0) {
+            config.io_threads = std::stoul(arg.substr(13));
+        } else if (arg.rfind("--outbound-low=", 0) == 0) {
+            config.outbound.low_watermark = std::stoul(arg.substr(15));
+        } else if (arg.rfind("--outbound-high=", 0) == 0) {
+            config.outbound.high_watermark = std::stoul(arg.substr(16));
+        } else if (arg.rfind("--outbound-max=", 0) == 0) {
+            config.outbound.hard_limit = std::stoul(arg.substr(15));
+        } else if (arg.rfind("--slow-consumer=", 0) == 0) {
+            std::string policy = arg.substr(16);
+            if (policy == "drop") {
+                config.outbound.policy = SlowConsumerPolicy::DropTyping;
+            } else if (policy == "pause") {
+                config.outbound.policy = SlowConsumerPolicy::PauseSender;
+            } else if (policy == "disconnect") {
+                config.outbound.policy = SlowConsumerPolicy::Disconnect;
+            } else {
+                return false;
+            }
+        } else if (arg.rfind("--login-timeout=", 0) == 0) {
+            config.timeouts.login_timeout = std::chrono::seconds(std::stol(arg.substr(16)));
+        } else if (arg.rfind("--heartbeat=", 0) == 0) {
+            config.timeouts.heartbeat_interval = std::chrono::seconds(std::stol(arg.substr(12)));
+        } else if (arg.rfind("--idle-timeout=", 0) == 0) {
+            config.timeouts.idle_timeout = std::chrono::seconds(std::stol(arg.substr(15)));
+        } else if (arg.rfind("--max-frame=", 0) == 0) {
+            config.max_frame_size = std::stoul(arg.substr(12));
+        } else if (arg.rfind("--log-level=", 0) == 0) {
+            LogLevel level;
+            if (!Logger::parseLevel(arg.substr(12), level)) {
+                return false;
+            }
+            Logger::instance().setLevel(level);
+        } else if (arg.rfind("--db=", 0) == 0) {
+            config.db_path = arg.substr(5);
+        } else if (arg.rfind("--db-sync=", 0) == 0) {
+            config.database.synchronous = arg.substr(10);
+            std::transform(config.database.synchronous.begin(), config.database.synchronous.end(),
+                           config.database.synchronous.begin(), [](unsigned char c) { return std::toupper(c); });
+            if (!Database::isValidSynchronousMode(config.database.synchronous)) {
+                return false;
+            }
+        } else if (arg.rfind("--db-cache-kib=", 0) == 0) {
+            config.database.cache_size_kib = std::stoul(arg.substr(15));
+        } else if (arg.rfind("--db-mmap=", 0) == 0) {
+            config.database.mmap_size = std::stoull(arg.substr(10));
+        } else if (arg.rfind("--db-readers=", 0) == 0) {
+            config.database.reader_connections = std::stoul(arg.substr(13));
+        } else if (arg.rfind("--db-batch=", 0) == 0) {
+            config.persistence.max_batch = std::stoul(arg.substr(11));
+        } else if (arg.rfind("--db-flush-ms=", 0) == 0) {
+            config.persistence.flush_interval = std::chrono::milliseconds(std::stol(arg.substr(14)));
+        } else if (arg.rfind("--typing-interval-ms=", 0) == 0) {
+            config.typing.interval = std::chrono::milliseconds(std::stol(arg.substr(21)));
+        } else if (arg.rfind("--presence-flush-ms=", 0) == 0) {
+            config.presence.flush_interval = std::chrono::milliseconds(std::stol(arg.substr(20)));
+        } else if (arg.rfind("--presence-max-subs=", 0) == 0) {
+            config.presence.max_subscriptions = std::stoul(arg.substr(20));
+        } else if (arg.rfind("--blob-dir=", 0) == 0) {
+            config.files.blob_dir = arg.substr(11);
+        } else if (arg.rfind("--file-chunk=", 0) == 0) {
+            config.files.chunk_size = std::stoul(arg.substr(13));
+        } else if (arg.rfind("--max-file-size=", 0) == 0) {
+            config.files.max_file_size = std::stoull(arg.substr(16));
+        } else if (arg.rfind("--max-open-uploads=", 0) == 0) {
+            config.files.max_open_uploads = std::stoul(arg.substr(19));
+        } else if (arg.rfind("--upload-quota=", 0) == 0) {
+            config.files.max_pending_bytes = std::stoull(arg.substr(15));
+        } else if (arg.rfind("--upload-expiry=", 0) == 0) {
+            config.files.stale_upload_after = std::chrono::seconds(std::stol(arg.substr(16)));
+        } else if (!port_set && !arg.empty() && arg[0] != '-') {
+            config.port = std::stoi(arg);
+            port_set = true;
+        } else {
+            return false;
+        }
+    }
+    return config.max_frame_size > 0 && config.persistence.max_batch > 0 &&
+           config.database.reader_connections > 0 && config.typing.interval.count() > 0 &&
+           config.presence.flush_interval.count() > 0 &&
+           config.files.chunk_size > 0 && config.files.max_file_size > 0 &&
+           config.files.stale_upload_after.count() > 0 &&
+           config.outbound.low_watermark <= config.outbound.high_watermark &&
+           config.outbound.high_watermark <= config.outbound.hard_limit &&
+           config.timeouts.heartbeat_interval < config.timeouts.idle_timeout;
+}
+
 int main(int argc, char* argv[]) {
     try {
-        int port = PORT;
-        if (argc > 2) {
-            std::cerr << "Usage: server <port>\n";
+        ServerConfig config;
+        config.port = PORT;
+        if (!parseArguments(argc, argv, config)) {
+            std::cerr << "Usage: server [port] [--io-threads=N] [--db=path] [--max-frame=BYTES]\n"
+                      << "              [--db-sync=off|normal|full|extra] [--db-cache-kib=KIB] [--db-mmap=BYTES]\n"
+                      << "              [--db-readers=N] [--db-batch=ROWS] [--db-flush-ms=MS]\n"
+                      << "              [--log-level=debug|info|warn|error]\n"
+                      << "              [--outbound-low=BYTES] [--outbound-high=BYTES] [--outbound-max=BYTES]\n"
+                      << "              [--slow-consumer=drop|pause|disconnect] [--typing-interval-ms=MS]\n"
+                      << "              [--presence-flush-ms=MS] [--presence-max-subs=N]\n"
+                      << "              [--blob-dir=path] [--file-chunk=BYTES] [--max-file-size=BYTES]\n"
+                      << "              [--max-open-uploads=N] [--upload-quota=BYTES] [--upload-expiry=SEC]\n"
+                      << "              [--login-timeout=SEC] [--heartbeat=SEC] [--idle-timeout=SEC]\n";
             return 1;
         }
-        else if (argc == 2) {
-            port = std::atoi(argv[1]);
-        }
-        std::cout << "Starting Asynchronous Messenger Server on port " << port << std::endl;
+        std::size_t thread_count = config.resolvedIoThreads();
+        Logger::instance().start();
+        LOG_INFO("starting asynchronous messenger server", "port", config.port);
         
-        boost::asio::io_context io_context;
-        Server server(io_context, port);
-        std::cout << "Server listening on port " << port << std::endl;
+        boost::asio::io_context io_context(static_cast<int>(thread_count));
+        Server server(io_context, config);
+        LOG_INFO("server listening", "port", config.port, "io_threads", thread_count, "backend", kIoBackend);
 
         // ShowJsonExamples();
 
+        // SIGINT/SIGTERM закрывают сессии; run() возвращается, когда работы не остается,
+        // и только потом деструктор Server дописывает очередь сообщений в БД
+        boost::asio::signal_set signals(io_context, SIGINT, SIGTERM);
+        signals.async_wait([&server](const boost::system::error_code& ec, int signal_number) {
+            if (!ec) {
+                LOG_INFO("shutting down", "signal", signal_number);
+                server.stop();
+            }
+        });
+
+        // Главный поток тоже обслуживает io_context
+        std::vector<std::thread> io_threads;
+        io_threads.reserve(thread_count - 1);
+        for (std::size_t i = 1; i < thread_count; ++i) {
+            io_threads.emplace_back([&io_context]() {
+                io_context.run();
+            });
+        }
+
         io_context.run();
+
+        for (auto& thread : io_threads) {
+            thread.join();
+        }
         
     } catch (std::exception& e) {
-        std::cerr << "Exception: " << e.what() << "\n";
+        LOG_ERROR("server exception", "error", e.what());
     }
 
+    Logger::instance().stop();
     return 0;
-}
\ No newline at end of file
+}
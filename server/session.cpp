@@ -1,38 +1,304 @@
 #include "include/session.h"
 #include "include/json_parser.h"
 #include "include/user_manager.h"
-#include <iostream>
+#include "include/logger.h"
+#include "commands.h"
+#include <algorithm>
+#include <ctime>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
 
-Session::Session(tcp::socket socket, std::shared_ptr<JsonParser> json_parser)
+#ifdef __linux__
+#include <cerrno>
+#include <sys/sendfile.h>
+#endif
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+namespace {
+// Asio issues at most 64 iovecs per writev, so larger batches gain nothing
+constexpr std::size_t kMaxBuffersPerWrite = 64;
+constexpr std::size_t kReadChunkSize = 8192;
+}
+
+OutboundStats Session::stats_;
+
+Session::Session(tcp::socket socket, std::shared_ptr<JsonParser> json_parser,
+                 TimingWheel& timing_wheel, const ServerConfig& config)
     : socket_(std::move(socket)), json_parser_(json_parser), 
-      authenticated_(false), user_id_(-1), closing_(false) {}
+      authenticated_(false), user_id_(-1), delivery_acks_(false),
+      frames_in_flight_(0), write_framing_(FramingMode::Newline),
+      payload_encoding_(PayloadEncoding::Json),
+      writing_(false), write_signal_(socket_.get_executor()),
+      limits_(config.outbound), queued_bytes_(0),
+      read_paused_(false), resume_signal_(socket_.get_executor()),
+      timing_wheel_(timing_wheel), timeouts_(config.timeouts), ping_sent_(false),
+      closing_(false), close_after_flush_(false) {
+    read_buffer_.setMaxFrameSize(config.max_frame_size);
+}
 
 Session::~Session() {
-    std::cout << "Session destroyed for user: " << username_ << std::endl;
+    timing_wheel_.cancel(timer_);
+    LOG_DEBUG("session destroyed", "user", username_);
 }
 
 void Session::start() {
-    std::cout << "New session started" << std::endl;
-    do_read();
+    LOG_INFO("session started");
+
+    // До логина действует только дедлайн аутентификации
+    auto now = std::chrono::steady_clock::now();
+    last_activity_ = now;
+    login_deadline_ = now + timeouts_.login_timeout;
+    armTimer(timeouts_.login_timeout);
+
+    auto executor = socket_.get_executor();
+    boost::asio::co_spawn(executor, reader(shared_from_this()), boost::asio::detached);
+    boost::asio::co_spawn(executor, writer(shared_from_this()), boost::asio::detached);
 }
 
-void Session::send(const nlohmann::json& message) {
+void Session::send(nlohmann::json message, SendPriority priority) {
     try {
-        std::string serialized = message.dump() + "\n";  // Добавляем разделитель
-        std::cout << "Sending to client: " << serialized.substr(0, serialized.length()-1) << std::endl;
-        
-        auto self(shared_from_this());
-        boost::asio::async_write(socket_, boost::asio::buffer(serialized),
-            [this, self](boost::system::error_code ec, std::size_t length) {
-                if (ec) {
-                    std::cerr << "Write error: " << ec.message() << std::endl;
-                    close();
-                } else {
-                    std::cout << "Successfully sent " << length << " bytes" << std::endl;
-                }
-            });
+        send(OutboundFrame::fromJson(std::move(message)), priority);
+    } catch (const std::exception& e) {
+        LOG_ERROR("error sending message", "error", e.what());
+    }
+}
+
+void Session::send(SharedFrame frame, SendPriority priority) {
+    LOG_DEBUG("sending to client", "user", username_, "payload", frame->payload());
+
+    // send() может вызываться из strand'а другой сессии (доставка сообщений),
+    // поэтому очередь трогаем только внутри своего strand'а
+    auto self(shared_from_this());
+    boost::asio::dispatch(socket_.get_executor(),
+        [this, self, frame = std::move(frame), priority]() mutable {
+            enqueue(std::move(frame), priority);
+        });
+}
+
+void Session::sendFileChunk(SharedFrame header, FileSlice slice) {
+    auto self(shared_from_this());
+    boost::asio::dispatch(socket_.get_executor(),
+        [this, self, header = std::move(header), slice = std::move(slice)]() mutable {
+            enqueueFileChunk(std::move(header), std::move(slice));
+        });
+}
+
+Session::OutboundEntry Session::makeEntry(SharedFrame frame, SendPriority priority) const {
+    // Фрейминг и кодировку выбираем здесь: они меняются только в strand'е.
+    // Сам payload общий для всех получателей и не копируется
+    OutboundEntry entry{std::move(frame), {}, {}, false, priority, 0, 0};
+    if (write_framing_ == FramingMode::LengthPrefixed) {
+        entry.body = entry.frame->payload(payload_encoding_);
+        FrameBuffer::encodeLengthPrefix(static_cast<std::uint32_t>(entry.body.size()), entry.prefix.data());
+        entry.prefixed = true;
+        entry.size = entry.prefix.size() + entry.body.size();
+    } else {
+        entry.body = entry.frame->newlineTerminated();
+        entry.size = entry.body.size();
+    }
+    return entry;
+}
+
+void Session::enqueue(SharedFrame frame, SendPriority priority) {
+    if (closing_) {
+        return;
+    }
+
+    OutboundEntry entry;
+    try {
+        entry = makeEntry(std::move(frame), priority);
     } catch (const std::exception& e) {
-        std::cerr << "Error sending message: " << e.what() << std::endl;
+        // Не кодируется только этот фрейм - сессия и сервер продолжают работу
+        LOG_ERROR("failed to encode frame, dropped", "user", username_, "error", e.what());
+        return;
+    }
+
+    std::size_t queued = queuedBytes();
+    if (queued + entry.size > limits_.high_watermark) {
+        if (priority == SendPriority::Droppable) {
+            stats_.frames_dropped++;
+            stats_.bytes_dropped += entry.size;
+            return;
+        }
+
+        // Клиент не успевает читать: сначала выбрасываем typing-события
+        dropQueuedDroppable();
+        queued = queuedBytes();
+
+        bool over_limit = queued + entry.size > limits_.hard_limit ||
+            (limits_.policy == SlowConsumerPolicy::Disconnect && queued + entry.size > limits_.high_watermark);
+        if (over_limit) {
+            stats_.slow_consumer_disconnects++;
+            LOG_WARN("slow consumer, disconnecting", "user", username_, "queued_bytes", queued,
+                     "total_disconnects", stats_.slow_consumer_disconnects.load());
+            close();
+            return;
+        }
+    }
+
+    queued_bytes_ += entry.size;
+    entry.ordinal = next_ordinal_++;
+    write_queue_.push_back(std::move(entry));
+    if (!writing_) {
+        write_signal_.cancel(); // Будим writer
+    }
+}
+
+void Session::enqueueFileChunk(SharedFrame header, FileSlice slice) {
+    if (closing_) {
+        return;
+    }
+    if (slice.length > 0 && write_framing_ != FramingMode::LengthPrefixed) {
+        LOG_ERROR("raw file chunk needs length-prefixed framing", "user", username_);
+        return;
+    }
+
+    // Лимиты очереди не проверяем: отправитель чанков сам ждет whenDrained()
+    FileChunkEntry chunk{{}, std::move(slice), {}, 0};
+    try {
+        chunk.header = makeEntry(std::move(header), SendPriority::Normal);
+    } catch (const std::exception& e) {
+        LOG_ERROR("failed to encode file chunk header, dropped", "user", username_, "error", e.what());
+        return;
+    }
+    chunk.size = chunk.header.size;
+    if (chunk.slice.length > 0) {
+        FrameBuffer::encodeLengthPrefix(static_cast<std::uint32_t>(chunk.slice.length), chunk.slice_prefix.data());
+        chunk.size += chunk.slice_prefix.size() + chunk.slice.length;
+    }
+
+    queued_bytes_ += chunk.size;
+    file_queue_.push_back(std::move(chunk));
+    if (!writing_) {
+        write_signal_.cancel(); // Будим writer
+    }
+}
+
+void Session::dropQueuedDroppable() {
+    // Фреймы, уже переданные в async_write, трогать нельзя
+    auto first = write_queue_.begin() + frames_in_flight_;
+    auto kept = std::stable_partition(first, write_queue_.end(), [](const OutboundEntry& entry) {
+        return entry.priority != SendPriority::Droppable;
+    });
+
+    for (auto it = kept; it != write_queue_.end(); ++it) {
+        queued_bytes_ -= it->size;
+        stats_.frames_dropped++;
+        stats_.bytes_dropped += it->size;
+    }
+    write_queue_.erase(kept, write_queue_.end());
+    if (!written_callbacks_.empty()) {
+        runWrittenCallbacks();
+    }
+}
+
+void Session::pauseSenderUntilDrained(const std::shared_ptr<Session>& sender) {
+    if (!sender || sender.get() == this) {
+        return;
+    }
+
+    sender->pauseReading();
+    stats_.sender_pauses++;
+
+    auto self(shared_from_this());
+    std::weak_ptr<Session> weak_sender = sender;
+    boost::asio::dispatch(socket_.get_executor(), [this, self, weak_sender]() {
+        auto paused = weak_sender.lock();
+        if (!paused) {
+            return;
+        }
+        if (closing_ || queuedBytes() <= limits_.low_watermark) {
+            paused->resumeReading(); // Очередь уже разгрузилась
+            return;
+        }
+        paused_senders_.push_back(weak_sender);
+    });
+}
+
+void Session::whenDrained(std::function<void()> callback) {
+    auto self(shared_from_this());
+    boost::asio::dispatch(socket_.get_executor(), [this, self, callback = std::move(callback)]() mutable {
+        if (closing_) {
+            return;
+        }
+        drain_callbacks_.push_back(std::move(callback));
+        if (queuedBytes() <= limits_.low_watermark) {
+            runDrainCallbacks();
+        }
+    });
+}
+
+void Session::whenWritten(std::function<void()> callback) {
+    auto self(shared_from_this());
+    boost::asio::dispatch(socket_.get_executor(), [this, self, callback = std::move(callback)]() mutable {
+        if (closing_) {
+            return;
+        }
+        written_callbacks_.emplace_back(next_ordinal_, std::move(callback));
+        runWrittenCallbacks();
+    });
+}
+
+void Session::post(std::function<void()> callback) {
+    auto self(shared_from_this());
+    boost::asio::post(socket_.get_executor(), [this, self, callback = std::move(callback)]() {
+        if (!closing_) {
+            callback();
+        }
+    });
+}
+
+void Session::runWrittenCallbacks() {
+    // Фреймы уходят из очереди по порядку: все, что старше первого оставшегося, записано
+    std::uint64_t pending = write_queue_.empty() ? next_ordinal_ : write_queue_.front().ordinal;
+    auto ready = std::stable_partition(written_callbacks_.begin(), written_callbacks_.end(),
+        [pending](const auto& entry) { return entry.first > pending; });
+    for (auto it = ready; it != written_callbacks_.end(); ++it) {
+        boost::asio::post(socket_.get_executor(), std::move(it->second));
+    }
+    written_callbacks_.erase(ready, written_callbacks_.end());
+}
+
+void Session::runDrainCallbacks() {
+    std::vector<std::function<void()>> callbacks;
+    callbacks.swap(drain_callbacks_);
+    for (auto& callback : callbacks) {
+        // post, а не прямой вызов: колбэк может снова вызвать whenDrained
+        boost::asio::post(socket_.get_executor(), std::move(callback));
+    }
+}
+
+void Session::pauseReading() {
+    auto self(shared_from_this());
+    boost::asio::dispatch(socket_.get_executor(), [this, self]() {
+        read_paused_ = true;
+    });
+}
+
+void Session::resumeReading() {
+    auto self(shared_from_this());
+    boost::asio::dispatch(socket_.get_executor(), [this, self]() {
+        if (!read_paused_) {
+            return;
+        }
+        read_paused_ = false;
+        last_activity_ = std::chrono::steady_clock::now();
+        ping_sent_ = false;
+        resume_signal_.cancel();
+    });
+}
+
+void Session::resumePausedSenders() {
+    std::vector<std::weak_ptr<Session>> senders;
+    senders.swap(paused_senders_);
+    for (auto& weak_sender : senders) {
+        if (auto sender = weak_sender.lock()) {
+            sender->resumeReading();
+        }
     }
 }
 
@@ -40,59 +306,302 @@ void Session::setAuthenticated(int user_id, const std::string& username) {
     authenticated_ = true;
     user_id_ = user_id;
     username_ = username;
-    std::cout << "Session authenticated for user: " << username << " (ID: " << user_id << ")" << std::endl;
+    LOG_INFO("session authenticated", "user", username, "user_id", user_id);
+
+    // Дальше сессию держат heartbeat'ы
+    ping_sent_ = false;
+    armTimer(timeouts_.heartbeat_interval);
+}
+
+void Session::armTimer(std::chrono::steady_clock::duration delay) {
+    std::weak_ptr<Session> weak_self = weak_from_this();
+    timing_wheel_.schedule(timer_, std::chrono::duration_cast<std::chrono::milliseconds>(delay),
+        [weak_self]() {
+            if (auto self = weak_self.lock()) {
+                boost::asio::post(self->socket_.get_executor(), [self]() {
+                    self->onTimer();
+                });
+            }
+        });
+}
+
+void Session::onTimer() {
+    if (closing_) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (!authenticated_) {
+        if (now >= login_deadline_) {
+            LOG_INFO("login timeout, closing unauthenticated session");
+            close();
+        } else {
+            armTimer(login_deadline_ - now);
+        }
+        return;
+    }
+
+    if (read_paused_) {
+        // Мы сами перестали читать из-за медленного получателя - pong'и клиента
+        // не видны, и молчание не его вина. Отсчет начнется заново с resumeReading()
+        armTimer(timeouts_.heartbeat_interval);
+        return;
+    }
+
+    auto idle = now - last_activity_;
+    if (idle >= timeouts_.idle_timeout) {
+        LOG_INFO("idle timeout, closing session", "user", username_);
+        close();
+        return;
+    }
+
+    if (idle >= timeouts_.heartbeat_interval) {
+        if (!ping_sent_) {
+            nlohmann::json ping;
+            ping["type"] = commandName(Command::Ping);
+            ping["timestamp"] = std::time(nullptr);
+            send(ping);
+            ping_sent_ = true;
+        }
+        armTimer(timeouts_.idle_timeout - idle);
+    } else {
+        armTimer(timeouts_.heartbeat_interval - idle);
+    }
+}
+
+void Session::setFramingMode(FramingMode mode) {
+    read_buffer_.setMode(mode);
+    write_framing_ = mode;
+    LOG_DEBUG("session framing switched", "framing",
+              mode == FramingMode::LengthPrefixed ? "length-prefixed" : "newline");
 }
 
 void Session::close() {
-    if (!closing_) {
+    auto self(shared_from_this());
+    boost::asio::dispatch(socket_.get_executor(), [this, self]() {
+        if (closing_) {
+            return;
+        }
         closing_ = true;
         
-        std::cout << "Closing session for user: " << username_ << std::endl;
+        LOG_INFO("closing session", "user", username_);
+        timing_wheel_.cancel(timer_);
         
         // Удаляем сессию из UserManager если пользователь был аутентифицирован
         if (authenticated_ && json_parser_) {
-            json_parser_->removeSessionFromManager(user_id_);
+            json_parser_->removeSessionFromManager(user_id_, this);
         }
         
         boost::system::error_code ec;
         socket_.shutdown(tcp::socket::shutdown_both, ec);
         socket_.close(ec);
+
+        // Корутины ждут сигналов - будим, чтобы они увидели closing_ и завершились
+        write_signal_.cancel();
+        resume_signal_.cancel();
+        resumePausedSenders();
+        drain_callbacks_.clear();
+        written_callbacks_.clear();
+    });
+}
+
+awaitable<void> Session::reader([[maybe_unused]] std::shared_ptr<Session> self) {
+    try {
+        while (!closing_) {
+            if (read_paused_) {
+                // Ждем resumeReading(): получатель разгрузил очередь
+                boost::system::error_code ec;
+                resume_signal_.expires_at(std::chrono::steady_clock::time_point::max());
+                co_await resume_signal_.async_wait(boost::asio::redirect_error(use_awaitable, ec));
+                continue;
+            }
+
+            // В length-prefixed режиме размер недостающей части фрейма известен заранее
+            std::size_t needed = std::max<std::size_t>(read_buffer_.bytesNeeded(), 1);
+            char* data = read_buffer_.prepare(std::max(needed, kReadChunkSize));
+            std::size_t length = co_await boost::asio::async_read(socket_,
+                boost::asio::buffer(data, read_buffer_.writable()),
+                boost::asio::transfer_at_least(needed), use_awaitable);
+
+            read_buffer_.commit(length);
+            last_activity_ = std::chrono::steady_clock::now();
+            ping_sent_ = false;
+            
+            // Обрабатываем все полные сообщения в буфере без копирования
+            std::string_view complete_message;
+            while (read_buffer_.nextFrame(complete_message)) {
+                if (!complete_message.empty()) {
+                    handle_message(complete_message);
+                }
+            }
+
+            if (read_buffer_.oversized()) {
+                rejectOversizedFrame();
+                co_return; // Сессию закроет writer после отправки ошибки
+            }
+        }
+    } catch (const boost::system::system_error& e) {
+        LOG_DEBUG("read finished", "user", username_, "reason", e.code().message());
     }
+    close();
 }
 
-void Session::do_read() {
-    auto self(shared_from_this());
-    
-    socket_.async_read_some(boost::asio::buffer(read_buffer_),
-        [this, self](boost::system::error_code ec, std::size_t length) {
-            if (!ec) {
-                // Добавляем полученные данные к буферу сообщений
-                message_buffer_.append(read_buffer_.data(), length);
-                
-                // Обрабатываем все полные сообщения в буфере
-                size_t pos = 0;
-                while ((pos = message_buffer_.find('\n')) != std::string::npos) {
-                    std::string complete_message = message_buffer_.substr(0, pos);
-                    message_buffer_.erase(0, pos + 1);
-                    
-                    if (!complete_message.empty()) {
-                        handle_message(complete_message);
-                    }
+void Session::rejectOversizedFrame() {
+    LOG_WARN("oversized frame, closing session", "user", username_, "max_frame_size", read_buffer_.maxFrameSize());
+
+    nlohmann::json error;
+    error["type"] = commandName(Command::ErrorResponse);
+    error["success"] = false;
+    error["message"] = "Frame exceeds " + std::to_string(read_buffer_.maxFrameSize()) + " bytes";
+    error["timestamp"] = std::time(nullptr);
+    enqueue(OutboundFrame::fromJson(error), SendPriority::Normal);
+
+    close_after_flush_ = true;
+    write_signal_.cancel();
+}
+
+awaitable<void> Session::writer([[maybe_unused]] std::shared_ptr<Session> self) {
+    try {
+        while (!closing_) {
+            if (write_queue_.empty() && !file_queue_.empty() && !close_after_flush_) {
+                // Чанк файла - только когда другие фреймы не ждут
+                co_await writeFileChunk(file_queue_.front());
+                std::size_t length = file_queue_.front().size;
+                file_queue_.pop_front();
+                onBytesWritten(length);
+                continue;
+            }
+
+            if (write_queue_.empty()) {
+                if (close_after_flush_) {
+                    break;
                 }
-                
-                do_read();
-            } else {
-                std::cout << "Read error: " << ec.message() << std::endl;
-                close();
+                boost::system::error_code ec;
+                write_signal_.expires_at(std::chrono::steady_clock::time_point::max());
+                co_await write_signal_.async_wait(boost::asio::redirect_error(use_awaitable, ec));
+                continue;
             }
-        });
+
+            // Собираем все ожидающие фреймы в один scatter-gather write
+            write_buffers_.clear();
+            frames_in_flight_ = 0;
+            while (frames_in_flight_ < write_queue_.size()) {
+                const OutboundEntry& entry = write_queue_[frames_in_flight_];
+                if (write_buffers_.size() + (entry.prefixed ? 2 : 1) > kMaxBuffersPerWrite) {
+                    break;
+                }
+                if (entry.prefixed) {
+                    write_buffers_.push_back(boost::asio::buffer(entry.prefix));
+                }
+                write_buffers_.push_back(boost::asio::buffer(entry.body.data(), entry.body.size()));
+                ++frames_in_flight_;
+            }
+
+            writing_ = true;
+            std::size_t length = co_await boost::asio::async_write(socket_, write_buffers_, use_awaitable);
+            writing_ = false;
+
+            LOG_DEBUG("frames sent", "user", username_, "frames", frames_in_flight_, "bytes", length);
+            write_queue_.erase(write_queue_.begin(), write_queue_.begin() + frames_in_flight_);
+            frames_in_flight_ = 0;
+            onBytesWritten(length);
+            if (!written_callbacks_.empty()) {
+                runWrittenCallbacks();
+            }
+        }
+
+        if (close_after_flush_ && !closing_) {
+            // Ответ отправлен. Закрываем свою сторону и выбрасываем остаток входящих
+            // данных: close() при непрочитанных байтах шлет RST, и клиент может не
+            // успеть прочитать ошибку. Бесконечный поток оборвет таймаут сессии
+            boost::system::error_code ec;
+            socket_.shutdown(tcp::socket::shutdown_send, ec);
+            std::array<char, 4096> discard;
+            while (!ec && !closing_) {
+                co_await socket_.async_read_some(boost::asio::buffer(discard),
+                    boost::asio::redirect_error(use_awaitable, ec));
+            }
+        }
+    } catch (const boost::system::system_error& e) {
+        LOG_WARN("write error", "user", username_, "error", e.code().message());
+    }
+
+    writing_ = false;
+    write_queue_.clear();
+    file_queue_.clear();
+    frames_in_flight_ = 0;
+    queued_bytes_ = 0;
+    close();
+}
+
+awaitable<void> Session::writeFileChunk(FileChunkEntry& chunk) {
+    // Заголовок и префикс сырого фрейма - одной записью, затем байты файла
+    write_buffers_.clear();
+    if (chunk.header.prefixed) {
+        write_buffers_.push_back(boost::asio::buffer(chunk.header.prefix));
+    }
+    write_buffers_.push_back(boost::asio::buffer(chunk.header.body.data(), chunk.header.body.size()));
+    if (chunk.slice.length > 0) {
+        write_buffers_.push_back(boost::asio::buffer(chunk.slice_prefix));
+    }
+
+    writing_ = true;
+    co_await boost::asio::async_write(socket_, write_buffers_, use_awaitable);
+    if (chunk.slice.length > 0) {
+        co_await writeFileSlice(chunk.slice);
+    }
+    writing_ = false;
+
+    LOG_DEBUG("file chunk sent", "user", username_, "offset", chunk.slice.offset, "bytes", chunk.size);
+}
+
+awaitable<void> Session::writeFileSlice(const FileSlice& slice) {
+#ifdef __linux__
+    // Ядро копирует страницы файла прямо в сокет; когда буфер сокета полон,
+    // ждем готовности на запись через reactor, не блокируя io-поток
+    socket_.native_non_blocking(true);
+    off_t offset = static_cast<off_t>(slice.offset);
+    std::size_t remaining = slice.length;
+    while (remaining > 0) {
+        ssize_t sent = ::sendfile(socket_.native_handle(), slice.file->nativeHandle(), &offset, remaining);
+        if (sent > 0) {
+            remaining -= static_cast<std::size_t>(sent);
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            co_await socket_.async_wait(tcp::socket::wait_write, use_awaitable);
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // sent == 0: файл оказался короче, чем обещал заголовок - клиента уже не выровнять
+            throw boost::system::system_error(sent == 0 ? boost::system::error_code(boost::asio::error::eof)
+                : boost::system::error_code(errno, boost::system::system_category()));
+        }
+    }
+#else
+    std::string data;
+    if (!slice.file->read(slice.offset, slice.length, data)) {
+        throw boost::system::system_error(boost::asio::error::eof);
+    }
+    co_await boost::asio::async_write(socket_, boost::asio::buffer(data), use_awaitable);
+#endif
+}
+
+void Session::onBytesWritten(std::size_t length) {
+    queued_bytes_ -= length;
+
+    if (queuedBytes() <= limits_.low_watermark) {
+        if (!paused_senders_.empty()) {
+            resumePausedSenders();
+        }
+        if (!drain_callbacks_.empty()) {
+            runDrainCallbacks();
+        }
+    }
 }
 
-void Session::handle_message(const std::string& message) {
+void Session::handle_message(std::string_view message) {
     try {
-        std::cout << "Handling message: " << message << std::endl;
         json_parser_->parseMessage(message, shared_from_this());
     } catch (const std::exception& e) {
-        std::cerr << "Error handling message: " << e.what() << std::endl;
+        LOG_ERROR("error handling message", "user", username_, "error", e.what());
     }
 }
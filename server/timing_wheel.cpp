@@ -0,0 +1,143 @@
+#include "include/timing_wheel.h"
+#include <algorithm>
+
+TimingWheel::TimingWheel(boost::asio::io_context& io_context, std::chrono::milliseconds tick)
+    : tick_timer_(boost::asio::make_strand(io_context)), tick_(tick), running_(false), current_tick_(0) {}
+
+TimingWheel::~TimingWheel() {
+    // io-потоки к этому моменту завершены, strand не нужен
+    running_ = false;
+    tick_timer_.cancel();
+}
+
+void TimingWheel::start() {
+    running_ = true;
+    next_tick_time_ = std::chrono::steady_clock::now() + tick_;
+    scheduleTick();
+}
+
+void TimingWheel::stop() {
+    // Тик выполняется на strand таймера - останавливаем там же, без гонки с scheduleTick
+    boost::asio::dispatch(tick_timer_.get_executor(), [this]() {
+        running_ = false;
+        tick_timer_.cancel();
+    });
+}
+
+void TimingWheel::schedule(Timer& timer, std::chrono::milliseconds delay, Callback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unlink(timer);
+
+    // Округляем вверх и добавляем тик на уже начавшийся интервал:
+    // таймер никогда не срабатывает раньше срока
+    std::uint64_t ticks = (delay.count() + tick_.count() - 1) / tick_.count();
+    timer.expiry_tick_ = current_tick_ + ticks + 1;
+    timer.callback_ = std::move(callback);
+    insert(timer);
+}
+
+void TimingWheel::cancel(Timer& timer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unlink(timer);
+    timer.callback_ = nullptr;
+}
+
+void TimingWheel::scheduleTick() {
+    // Отсчитываем от планового времени, а не от момента срабатывания, чтобы не копить дрейф
+    tick_timer_.expires_at(next_tick_time_);
+    tick_timer_.async_wait([this](boost::system::error_code ec) {
+        if (ec || !running_) {
+            return;
+        }
+        next_tick_time_ += tick_;
+        onTick();
+        scheduleTick();
+    });
+}
+
+void TimingWheel::onTick() {
+    std::vector<Callback> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++current_tick_;
+
+        // Раз в kSlots тиков переносим следующий интервал второго уровня в первый
+        if (current_tick_ % kSlots == 0) {
+            Timer*& cascade = level1_[(current_tick_ / kSlots) % kSlots];
+            Timer* timer = cascade;
+            cascade = nullptr;
+            while (timer != nullptr) {
+                Timer* next = timer->next_;
+                timer->prev_ = timer->next_ = nullptr;
+                timer->slot_ = nullptr;
+                insert(*timer);
+                timer = next;
+            }
+        }
+
+        Timer*& slot = level0_[current_tick_ % kSlots];
+        Timer* timer = slot;
+        slot = nullptr;
+        while (timer != nullptr) {
+            Timer* next = timer->next_;
+            timer->prev_ = timer->next_ = nullptr;
+            timer->slot_ = nullptr;
+            if (timer->expiry_tick_ <= current_tick_) {
+                expired.push_back(std::move(timer->callback_));
+                timer->callback_ = nullptr;
+            } else {
+                insert(*timer); // Запаркованный дальний таймер
+            }
+            timer = next;
+        }
+    }
+
+    // Колбэки вызываются без блокировки: они могут сразу перепланировать таймер
+    for (auto& callback : expired) {
+        if (callback) {
+            callback();
+        }
+    }
+}
+
+void TimingWheel::insert(Timer& timer) {
+    // delta == 0 бывает только при каскаде: такой таймер попадает в текущий слот
+    // и срабатывает в этом же тике
+    std::uint64_t delta = timer.expiry_tick_ > current_tick_ ? timer.expiry_tick_ - current_tick_ : 0;
+
+    Timer** head;
+    if (delta < kSlots) {
+        head = &level0_[(current_tick_ + delta) % kSlots];
+    } else if (delta < kSlots * (kSlots - 1)) {
+        head = &level1_[(timer.expiry_tick_ / kSlots) % kSlots];
+    } else {
+        // Дальше охвата колеса: паркуем в самом дальнем слоте
+        head = &level1_[(current_tick_ / kSlots + kSlots - 1) % kSlots];
+    }
+
+    timer.slot_ = head;
+    timer.prev_ = nullptr;
+    timer.next_ = *head;
+    if (*head != nullptr) {
+        (*head)->prev_ = &timer;
+    }
+    *head = &timer;
+}
+
+void TimingWheel::unlink(Timer& timer) {
+    if (timer.slot_ == nullptr) {
+        return;
+    }
+
+    if (timer.prev_ != nullptr) {
+        timer.prev_->next_ = timer.next_;
+    } else {
+        *timer.slot_ = timer.next_;
+    }
+    if (timer.next_ != nullptr) {
+        timer.next_->prev_ = timer.prev_;
+    }
+
+    timer.prev_ = timer.next_ = nullptr;
+    timer.slot_ = nullptr;
+}
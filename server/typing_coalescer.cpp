@@ -0,0 +1,117 @@
+#include "include/typing_coalescer.h"
+
+TypingCoalescer::TypingCoalescer(TimingWheel& timing_wheel, const TypingSettings& settings, Forward forward)
+    : timing_wheel_(timing_wheel), settings_(settings), forward_(std::move(forward)) {}
+
+TypingCoalescer::~TypingCoalescer() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [key, state] : pairs_) {
+        timing_wheel_.cancel(state->timer);
+    }
+}
+
+void TypingCoalescer::update(std::string_view from, std::string_view to, bool is_typing) {
+    auto now = Clock::now();
+    std::string key = pairKey(from, to);
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto it = pairs_.find(key);
+    if (it == pairs_.end()) {
+        if (!is_typing) {
+            return; // Получатель и так не видит "печатает"
+        }
+        auto state = std::make_unique<PairState>();
+        state->from = std::string(from);
+        state->to = std::string(to);
+        state->last_update = now;
+        it = pairs_.emplace(key, std::move(state)).first;
+    } else {
+        PairState& state = *it->second;
+        state.last_update = now;
+
+        if (state.pending) {
+            // Таймер уже взведен: запоминаем только последнее состояние
+            state.pending = is_typing;
+            if (*state.pending == state.forwarded) {
+                state.pending.reset();
+            }
+            return;
+        }
+
+        bool within_interval = now - state.last_forward < settings_.interval;
+        if (is_typing == state.forwarded) {
+            if (!is_typing || within_interval) {
+                return; // Повтор уже отправленного состояния
+            }
+        } else if (within_interval) {
+            state.pending = is_typing;
+            return;
+        }
+    }
+
+    PairState& state = *it->second;
+    markForwardedLocked(key, state, is_typing, now);
+    std::string from_username = state.from;
+    std::string to_username = state.to;
+    lock.unlock();
+
+    forward_(from_username, to_username, is_typing);
+}
+
+std::string TypingCoalescer::pairKey(std::string_view from, std::string_view to) {
+    std::string key;
+    key.reserve(from.size() + to.size() + 1);
+    key.append(from);
+    key += '\0'; // Не встречается в именах, пары не склеиваются
+    key.append(to);
+    return key;
+}
+
+void TypingCoalescer::markForwardedLocked(const std::string& key, PairState& state, bool is_typing,
+                                          Clock::time_point now) {
+    state.forwarded = is_typing;
+    state.last_forward = now;
+    armLocked(key, state, settings_.interval);
+}
+
+void TypingCoalescer::armLocked(const std::string& key, PairState& state, std::chrono::milliseconds delay) {
+    std::uint64_t generation = ++state.generation;
+    timing_wheel_.schedule(state.timer, delay, [this, key, generation]() {
+        onTimer(key, generation);
+    });
+}
+
+void TypingCoalescer::onTimer(const std::string& key, std::uint64_t generation) {
+    auto now = Clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto it = pairs_.find(key);
+    if (it == pairs_.end() || it->second->generation != generation) {
+        return; // Пару уже удалили или таймер перевзвели
+    }
+    PairState& state = *it->second;
+    std::string from_username = state.from;
+    std::string to_username = state.to;
+
+    bool is_typing;
+    if (state.pending) {
+        is_typing = *state.pending;
+        state.pending.reset();
+        markForwardedLocked(key, state, is_typing, now);
+    } else if (!state.forwarded) {
+        pairs_.erase(it); // "Не печатает" уже отправлено, запись больше не нужна
+        return;
+    } else {
+        auto idle = now - state.last_update;
+        if (idle < settings_.expiry) {
+            armLocked(key, state, std::chrono::duration_cast<std::chrono::milliseconds>(settings_.expiry - idle));
+            return;
+        }
+        // Отправитель пропал, не сняв статус (например, отключился)
+        is_typing = false;
+        pairs_.erase(it);
+    }
+    lock.unlock();
+
+    forward_(from_username, to_username, is_typing);
+}
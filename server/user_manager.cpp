@@ -1,9 +1,9 @@
 #include "include/user_manager.h"
 #include "include/session.h"
-#include <iostream>
+#include "include/logger.h"
 #include <functional>
 
-UserManager::UserManager(Database& db) : db_(db) {}
+UserManager::UserManager(Database& db, PresenceManager& presence) : db_(db), presence_(presence) {}
 
 std::string UserManager::hashPassword(const std::string& password) {
     // Простая реализация хеширования, но в реальном проекте будет использоваться bcrypt или подобные!
@@ -21,7 +21,7 @@ bool UserManager::registerUser(const std::string& username, const std::string& e
         // Проверяем, существует ли пользователь
         auto existing_user = db_.getUser(username);
         if (existing_user != nullptr) {
-            std::cout << "User " << username << " already exists!" << std::endl;
+            LOG_INFO("registration rejected, user exists", "user", username);
             return false;
         }
         
@@ -30,12 +30,12 @@ bool UserManager::registerUser(const std::string& username, const std::string& e
         bool result = db_.addUser(username, email, password_hash);
         
         if (result) {
-            std::cout << "User " << username << " registered successfully!" << std::endl;
+            LOG_INFO("user registered", "user", username);
         }
         
         return result;
     } catch (const std::exception& e) {
-        std::cerr << "Error registering user: " << e.what() << std::endl;
+        LOG_ERROR("error registering user", "user", username, "error", e.what());
         return false;
     }
 }
@@ -44,52 +44,97 @@ bool UserManager::authenticateUser(const std::string& username, const std::strin
     try {
         auto user = db_.getUser(username);
         if (user == nullptr) {
-            std::cout << "User " << username << " not found!" << std::endl;
+            LOG_INFO("login rejected, user not found", "user", username);
             return false;
         }
         
         if (verifyPassword(password, user->password_hash)) {
             user_id = user->id;
-            std::cout << "User " << username << " authenticated successfully!" << std::endl;
+            LOG_DEBUG("user authenticated", "user", username);
             return true;
         } else {
-            std::cout << "Invalid password for user " << username << std::endl;
+            LOG_INFO("login rejected, invalid password", "user", username);
             return false;
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error authenticating user: " << e.what() << std::endl;
+        LOG_ERROR("error authenticating user", "user", username, "error", e.what());
         return false;
     }
 }
 
 void UserManager::addSession(int user_id, const std::string& username, std::shared_ptr<Session> session) {
-    // Удаляем предыдущую сессию, если есть
-    removeSession(user_id);
-    
-    active_sessions_[user_id] = session;
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
+
+    // Предыдущая сессия пользователя (если была) просто заменяется
+    auto [it, inserted] = active_sessions_.insert_or_assign(user_id, session);
     user_id_to_username_[user_id] = username;
+    username_to_user_id_[username] = user_id;
+    if (inserted) {
+        presence_.publish(username, true); // Под sessions_mutex_: переходы одного пользователя не переставятся
+    }
     
-    std::cout << "Session added for user: " << username << " (ID: " << user_id << ")" << std::endl;
-    std::cout << "Total active sessions: " << active_sessions_.size() << std::endl;
+    LOG_INFO("session added", "user", username, "user_id", user_id, "active_sessions", active_sessions_.size());
 }
 
-void UserManager::removeSession(int user_id) {
+void UserManager::removeSession(int user_id, const Session* expected) {
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
+
+    // Подписки принадлежат соединению, даже если пользователь уже зашел заново
+    if (expected != nullptr) {
+        presence_.removeSubscriber(expected);
+    }
+
     auto it = active_sessions_.find(user_id);
     if (it != active_sessions_.end()) {
+        if (expected != nullptr && it->second.get() != expected) {
+            return; // Пользователь уже переподключился другой сессией
+        }
+
         std::string username = user_id_to_username_[user_id];
         active_sessions_.erase(it);
         user_id_to_username_.erase(user_id);
+        username_to_user_id_.erase(username);
+        presence_.publish(username, false);
         
-        std::cout << "Session removed for user: " << username << " (ID: " << user_id << ")" << std::endl;
-        std::cout << "Total active sessions: " << active_sessions_.size() << std::endl;
+        LOG_INFO("session removed", "user", username, "user_id", user_id, "active_sessions", active_sessions_.size());
     }
 }
 
+bool UserManager::subscribePresence(const std::shared_ptr<Session>& session, const std::vector<std::string>& usernames,
+                                    std::vector<std::string>& online) {
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
+
+    // Снимок и подписка под одним локом: ни один переход между ними не потеряется
+    std::vector<std::pair<std::string, bool>> users;
+    users.reserve(usernames.size());
+    for (const auto& username : usernames) {
+        bool is_online = username_to_user_id_.count(username) != 0;
+        users.emplace_back(username, is_online);
+    }
+    if (!presence_.subscribe(session, users)) {
+        return false;
+    }
+
+    online.clear();
+    for (const auto& [username, is_online] : users) {
+        if (is_online) {
+            online.push_back(username);
+        }
+    }
+    return true;
+}
+
+void UserManager::unsubscribePresence(const Session* session, const std::vector<std::string>& usernames) {
+    presence_.unsubscribe(session, usernames);
+}
+
 bool UserManager::isSessionActive(int user_id) {
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
     return active_sessions_.find(user_id) != active_sessions_.end();
 }
 
 std::shared_ptr<Session> UserManager::getSession(int user_id) {
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
     auto it = active_sessions_.find(user_id);
     if (it != active_sessions_.end()) {
         return it->second;
@@ -97,14 +142,14 @@ std::shared_ptr<Session> UserManager::getSession(int user_id) {
     return nullptr;
 }
 
-std::shared_ptr<Session> UserManager::getSessionByUsername(const std::string& username) {
-    // Найдем user_id по username
-    for (const auto& pair : user_id_to_username_) {
-        if (pair.second == username) {
-            return getSession(pair.first);
-        }
+std::shared_ptr<Session> UserManager::getSessionByUsername(std::string_view username) {
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
+    auto user = username_to_user_id_.find(username);
+    if (user == username_to_user_id_.end()) {
+        return nullptr;
     }
-    return nullptr;
+    auto it = active_sessions_.find(user->second);
+    return it != active_sessions_.end() ? it->second : nullptr;
 }
 
 std::unique_ptr<User> UserManager::getUser(const std::string& username) {